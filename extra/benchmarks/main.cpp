@@ -1,5 +1,10 @@
+#include <algorithm>
 #include <chrono>
+#include <cmath>
+#include <fstream>
 #include <iostream>
+#include <map>
+#include <sstream>
 
 #include "../model.hpp"
 
@@ -7,35 +12,123 @@ Registry<Archetypes, Events, Singletons> reg;
 
 int entity_count = 0;
 
-template <typename F>
-void benchmark(std::string msg, F func, int iterations = 1000)
+// Settings from the command line, see usage().
+struct Options
 {
-    auto start = std::chrono::high_resolution_clock::now();
-    for (int i = 0; i < iterations; ++i) func();
-    auto stop = std::chrono::high_resolution_clock::now();
-    
-    auto total_duration = std::chrono::duration_cast<std::chrono::nanoseconds>(stop - start);
-    auto avg_duration = total_duration.count() / iterations;
-    float avg_per_entity = static_cast<float>(avg_duration) / static_cast<float>(entity_count); 
+    int warmup = 3; // Untimed samples before measuring.
+    int samples = 30; // Timed samples per benchmark.
+    int iterations = 100; // Calls per sample, averaged.
+    std::vector<size_t> threads = {1, 2, 4};
+    std::string json;
+    std::string csv;
+    std::string baseline;
+    bool memory = false;
+};
+
+Options options;
+
+// Statistics of one benchmark over its samples, in nanoseconds per call.
+struct Result
+{
+    std::string name;
+    int samples;
+    int iterations;
+    double mean;
+    double median;
+    double p95;
+    double p99;
+    double stddev;
+    double min;
+    double max;
+};
+
+std::vector<Result> results;
+
+// Nearest-rank percentile of sorted samples.
+double percentile(const std::vector<double>& sorted, double p)
+{
+    size_t rank = static_cast<size_t>(std::ceil(p * sorted.size()));
+    return sorted[std::clamp<size_t>(rank, 1, sorted.size()) - 1];
+}
+
+/**
+ * Times a function: runs the warmup samples, then every sample calls it 
+ * iterations times and records the average duration of a call. Setup runs 
+ * before every sample and is not timed.
+ */
+template <typename F, typename Setup = void (*)()>
+void benchmark(std::string msg, F func, int iterations = options.iterations, Setup setup = [](){})
+{
+    auto sample = [&func, &setup, &iterations]()
+    {
+        setup();
+
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < iterations; ++i) func();
+        auto stop = std::chrono::steady_clock::now();
+
+        return static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(stop - start).count()) / iterations;
+    };
+
+    for (int i = 0; i < options.warmup; i++) sample();
+
+    std::vector<double> times;
+    for (int i = 0; i < options.samples; i++) times.push_back(sample());
+
+    std::sort(times.begin(), times.end());
+
+    double mean = 0;
+    for (double t : times) mean += t;
+    mean /= times.size();
+
+    double variance = 0;
+    for (double t : times) variance += (t - mean) * (t - mean);
+
+    // Names used to end with ": " in the text output, keep them clean for JSON and CSV.
+    std::string name = msg.substr(0, msg.find_last_not_of(": ") + 1);
+
+    Result r = 
+    {
+        name, options.samples, iterations, mean, percentile(times, 0.5), percentile(times, 0.95), percentile(times, 0.99), 
+        std::sqrt(variance / times.size()), times.front(), times.back()
+    };
+
+    results.push_back(r);
 
     std::cout 
     << "\n------------------------------------------------"
     << "\n" << msg
-    << "\n - Average duration: " << avg_duration << "ns"
-    << "\n - Average per entity: " << avg_per_entity << "ns"
-    << "\n - Iterations: " << iterations
+    << "\n - Average duration: " << static_cast<long long>(r.mean) << "ns"
+    << "\n - Average per entity: " << static_cast<float>(r.mean) / static_cast<float>(entity_count) << "ns"
+    << "\n - Median: " << static_cast<long long>(r.median) << "ns"
+    << "\n - p95: " << static_cast<long long>(r.p95) << "ns"
+    << "\n - p99: " << static_cast<long long>(r.p99) << "ns"
+    << "\n - Stddev: " << static_cast<long long>(r.stddev) << "ns"
+    << "\n - Iterations: " << iterations << " x " << options.samples << " samples"
     << "\n - Entities: " << entity_count
     << "\n------------------------------------------------";
 }
 
 void benchmark_create()
 {
-    benchmark("Create 3 components: ", [](){
+    std::unique_ptr<Registry<Archetypes, Events, Singletons>> local;
+
+    benchmark("Create 3 components: ", [&local](){
         for (int i = 0; i < entity_count; i++)
         {
-            reg.create(A3());
+            local->create(A3());
         }
-    }, 1);
+    }, 1, [&local](){ local = std::make_unique<Registry<Archetypes, Events, Singletons>>(); });
+
+    benchmark("Populate 3 components: ", [&local](){
+        local->populate(A3(), entity_count);
+    }, 1, [&local](){ local = std::make_unique<Registry<Archetypes, Events, Singletons>>(); });
+
+    // The other benchmarks run on the same entities as always.
+    for (int i = 0; i < entity_count; i++)
+    {
+        reg.create(A3());
+    }
 }
 
 void benchmark_query()
@@ -206,15 +299,297 @@ void benchmark_find()
     });
 }
 
+void benchmark_memory()
+{
+    MemoryReport report = reg.memory_report();
+
+    std::cout 
+    << "\n------------------------------------------------"
+    << "\nMemory: ";
+
+    for (const ArchetypeReport& archetype : report.archetypes)
+    {
+        std::cout 
+        << "\n - " << archetype.name 
+        << ": " << archetype.living.count << " entities, " 
+        << archetype.living.bytes + archetype.sleeping.bytes << "B reserved, " 
+        << archetype.living.dead + archetype.sleeping.dead << " dead slots";
+    }
+
+    std::cout
+    << "\n - Pools: " << report.pool_bytes << "B"
+    << "\n - Component heap: " << report.heap_bytes << "B"
+    << "\n - Metadata: " << report.metadata_bytes << "B"
+    << "\n - Total: " << report.total() << "B"
+    << "\n - Peak RSS: " << peak_rss() << "B"
+    << "\n------------------------------------------------";
+}
+
+void benchmark_state()
+{
+    std::vector<EntityId> ids(reg.ids<A3>().begin(), reg.ids<A3>().end());
+
+    benchmark("Queue snooze & wake, update: ", [&ids](){
+        for (EntityId id : ids) reg.queue(id, SNOOZE);
+        reg.update();
+        for (EntityId id : ids) reg.queue(id, WAKE);
+        reg.update();
+    }, 1);
+
+    benchmark("Queue snooze & wake, ordered update: ", [&ids](){
+        for (EntityId id : ids) reg.queue(id, SNOOZE);
+        reg.update(true);
+        for (EntityId id : ids) reg.queue(id, WAKE);
+        reg.update(true);
+    }, 1);
+
+    benchmark("Execute snooze & wake: ", [&ids](){
+        for (EntityId id : ids) reg.execute(id, SNOOZE);
+        for (EntityId id : ids) reg.execute(id, WAKE);
+    }, 1);
+
+    // Kills every tenth entity, the killed entities are replaced before each sample.
+    Registry<Archetypes, Events, Singletons> local;
+    std::vector<EntityId> victims;
+
+    benchmark("Queue kill 10%, update: ", [&local, &victims](){
+        for (EntityId id : victims) local.queue(id, KILL);
+        local.update();
+    }, 1, [&local, &victims](){
+        local.populate(A3(), entity_count - local.pool_count<A3>());
+
+        victims.clear();
+        for (size_t i = 0; i < local.pool_count<A3>(); i += 10) victims.push_back(local.ids<A3>()[i]);
+    });
+
+    // Shrinks a pool that just lost a tenth of its entities.
+    Registry<Archetypes, Events, Singletons> shrinking;
+
+    benchmark("Shrink after kill 10%: ", [&shrinking](){
+        shrinking.shrink<A3>();
+    }, 1, [&shrinking](){
+        shrinking.populate(A3(), entity_count - shrinking.pool_count<A3>());
+
+        for (size_t i = 0; i < shrinking.pool_count<A3>(); i += 10) shrinking.queue(shrinking.ids<A3>()[i], KILL);
+        shrinking.update();
+    });
+
+    // The same kills, with a trim policy that shrinks the pool inside update. Compare with "Queue kill 10%, update".
+    Registry<Archetypes, Events, Singletons> trimming;
+    trimming.trim_policy({.shrink_below = 0.95, .min_capacity = 0});
+
+    benchmark("Queue kill 10%, update with trim policy: ", [&trimming, &victims](){
+        for (EntityId id : victims) trimming.queue(id, KILL);
+        trimming.update();
+    }, 1, [&trimming, &victims](){
+        trimming.populate(A3(), entity_count - trimming.pool_count<A3>());
+
+        victims.clear();
+        for (size_t i = 0; i < trimming.pool_count<A3>(); i += 10) victims.push_back(trimming.ids<A3>()[i]);
+    });
+}
+
+void benchmark_events()
+{
+    Registry<Archetypes, Events, Singletons> local;
+    size_t received = 0;
+
+    local.subscribe<AEvent>([&received](AEvent e) { received += e.value; });
+
+    benchmark("Call event, immediate subscriber: ", [&local](){
+        for (int i = 0; i < entity_count; i++) local.call(AEvent{1});
+    }, 1);
+
+    Registry<Archetypes, Events, Singletons> batched;
+
+    batched.subscribe<BEvent>([&received](std::span<const BEvent> events) 
+    { 
+        for (const BEvent& e : events) received += e.value; 
+    });
+
+    benchmark("Call & dispatch event, batch subscriber: ", [&batched](){
+        for (int i = 0; i < entity_count; i++) batched.call(BEvent{1});
+        batched.dispatch_events();
+    }, 1);
+
+    Registry<Archetypes, Events, Singletons, Data<>, ObserveNone> quiet;
+
+    benchmark("Create 3 components, no built-in events: ", [&quiet](){
+        for (int i = 0; i < entity_count; i++) quiet.create(A3());
+    }, 1, [&quiet](){ 
+        for (size_t i = 0; i < quiet.pool_count<A3>(); i++) quiet.queue(quiet.ids<A3>()[i], KILL);
+        quiet.update();
+    });
+}
+
+void benchmark_parallel()
+{
+    for (size_t threads : options.threads)
+    {
+        reg.set_workers(threads);
+        std::string suffix = " (" + std::to_string(threads) + " threads): ";
+
+        benchmark("1-component par_for_each" + suffix, [](){
+            reg.query<Health>().par_for_each(reg.workers(), [](Extraction<Health> e)
+            {
+                std::get<0>(e.second).value++;
+            });
+        });
+
+        Scheduler<decltype(reg)> scheduler(reg);
+
+        scheduler
+            .add<Health>("health", [](Query<Health>& q) { q.for_each([](Extraction<Health> e) { std::get<0>(e.second).value++; }); })
+            .add<Position>("position", [](Query<Position>& q) { q.for_each([](Extraction<Position> e) { std::get<0>(e.second).x++; }); })
+            .add<Name>("name", [](Query<Name>& q) { q.for_each([](Extraction<Name> e) { std::get<0>(e.second).value = "F"; }); });
+
+        benchmark("3 disjoint scheduled systems" + suffix, [&scheduler](){
+            scheduler.run();
+        });
+
+        std::vector<EntityId> ids(reg.ids<A3>().begin(), reg.ids<A3>().end());
+
+        benchmark("Queue snooze & wake, parallel update" + suffix, [&ids](){
+            for (EntityId id : ids) reg.queue(id, SNOOZE);
+            reg.update(false, true);
+            for (EntityId id : ids) reg.queue(id, WAKE);
+            reg.update(false, true);
+        }, 1);
+    }
+}
+
+// Reads the average durations of a results/*.txt file, by benchmark name.
+auto read_baseline(const std::string& path) -> std::map<std::string, double>
+{
+    std::map<std::string, double> baseline;
+    std::ifstream in(path);
+    std::string line, name;
+
+    while (std::getline(in, line))
+    {
+        const std::string key = " - Average duration: ";
+
+        if (line.rfind(key, 0) == 0)
+        {
+            baseline[name] = std::stod(line.substr(key.size()));
+        }
+        else if (!line.empty() && line[0] != ' ' && line[0] != '-' && line[0] != '=')
+        {
+            name = line.substr(0, line.find_last_not_of(": ") + 1);
+        }
+    }
+
+    return baseline;
+}
+
+void compare_baseline()
+{
+    std::map<std::string, double> baseline = read_baseline(options.baseline);
+
+    if (baseline.empty())
+    {
+        std::cerr << "\nNo baseline results in " << options.baseline << "\n";
+        return;
+    }
+
+    std::cout 
+    << "\n------------------------------------------------"
+    << "\nCompared to " << options.baseline << ":";
+
+    for (const Result& r : results)
+    {
+        auto it = baseline.find(r.name);
+        if (it == baseline.end() || it->second == 0) continue;
+
+        std::cout << "\n - " << r.name << ": " << static_cast<long long>(it->second) << "ns -> " 
+        << static_cast<long long>(r.mean) << "ns (" << r.mean / it->second * 100 << "%)";
+    }
+
+    std::cout << "\n------------------------------------------------";
+}
+
+void write_json()
+{
+    std::ofstream out(options.json);
+
+    out << "{\n  \"entities\": " << entity_count << ",\n  \"benchmarks\": [";
+
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        const Result& r = results[i];
+
+        out << (i ? ",\n" : "\n") 
+        << "    {\"name\": \"" << r.name << "\", \"samples\": " << r.samples << ", \"iterations\": " << r.iterations
+        << ", \"mean_ns\": " << r.mean << ", \"median_ns\": " << r.median << ", \"p95_ns\": " << r.p95 
+        << ", \"p99_ns\": " << r.p99 << ", \"stddev_ns\": " << r.stddev << ", \"min_ns\": " << r.min 
+        << ", \"max_ns\": " << r.max << "}";
+    }
+
+    out << "\n  ]\n}\n";
+}
+
+void write_csv()
+{
+    std::ofstream out(options.csv);
+
+    out << "name,entities,samples,iterations,mean_ns,median_ns,p95_ns,p99_ns,stddev_ns,min_ns,max_ns\n";
+
+    for (const Result& r : results)
+    {
+        out << "\"" << r.name << "\"," << entity_count << "," << r.samples << "," << r.iterations << "," << r.mean << "," 
+        << r.median << "," << r.p95 << "," << r.p99 << "," << r.stddev << "," << r.min << "," << r.max << "\n";
+    }
+}
+
+void usage()
+{
+    std::cerr 
+    << "Usage: benchmarks <entities> [options]\n"
+    << "  --warmup <n>        untimed samples per benchmark (3)\n"
+    << "  --samples <n>       timed samples per benchmark (30)\n"
+    << "  --iterations <n>    calls per sample of repeatable benchmarks (100)\n"
+    << "  --threads <a,b,..>  thread counts of the parallel benchmarks (1,2,4)\n"
+    << "  --json <file>       write results as JSON\n"
+    << "  --csv <file>        write results as CSV\n"
+    << "  --baseline <file>   compare against a results/*.txt file\n"
+    << "  --memory            print a memory report and the peak RSS\n";
+}
+
 int main(int argc, char* argv[])
 {
     if (argc < 2) {
-        std::cerr << "Usage: benchmarks.exe <int>\n";
+        usage();
         return 1;
     }
 
     entity_count = std::stoi(argv[1]);
 
+    for (int i = 2; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+
+        if (arg == "--memory") options.memory = true;
+        else if (arg == "--warmup" && has_value) options.warmup = std::stoi(argv[++i]);
+        else if (arg == "--samples" && has_value) options.samples = std::max(1, std::stoi(argv[++i]));
+        else if (arg == "--iterations" && has_value) options.iterations = std::max(1, std::stoi(argv[++i]));
+        else if (arg == "--json" && has_value) options.json = argv[++i];
+        else if (arg == "--csv" && has_value) options.csv = argv[++i];
+        else if (arg == "--baseline" && has_value) options.baseline = argv[++i];
+        else if (arg == "--threads" && has_value)
+        {
+            options.threads.clear();
+            std::stringstream list(argv[++i]);
+
+            for (std::string count; std::getline(list, count, ',');) options.threads.push_back(std::stoul(count));
+        }
+        else 
+        {
+            usage();
+            return 1;
+        }
+    }
+
     std::cout << "\n=== Running benchmarks for: " << entity_count << " entities ===";
 
     benchmark_create();
@@ -223,6 +598,14 @@ int main(int argc, char* argv[])
     benchmark_get();
     benchmark_view();
     benchmark_find();
+    benchmark_state();
+    benchmark_events();
+    benchmark_parallel();
+
+    if (options.memory) benchmark_memory();
+    if (!options.baseline.empty()) compare_baseline();
+    if (!options.json.empty()) write_json();
+    if (!options.csv.empty()) write_csv();
 
     std::cout << "\n=== Benchmarks succeeded ===\n";
 
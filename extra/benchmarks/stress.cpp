@@ -0,0 +1,426 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <random>
+
+#include "../../necs.hpp"
+
+using namespace NECS;
+
+// Macro benchmarks that run whole frames on larger worlds: many overlapping
+// archetypes, spawn & kill churn, sleeping & waking populations and a headless
+// bouncing balls simulation. Each reports its frame times and the memory
+// high-water mark of its registry.
+
+// COMPONENTS
+
+// Every wide archetype has it.
+struct Shared { float value; };
+
+// Shared by every tenth wide archetype.
+template <size_t N>
+struct Layer { float value; };
+
+// Shared by ten consecutive wide archetypes.
+template <size_t N>
+struct Group { int value; };
+
+// ARCHETYPES
+
+constexpr size_t WIDE_COUNT = 100;
+
+// Each pair of layer and group is unique, so every archetype is distinct.
+template <size_t K>
+using Wide = Data<Shared, Layer<K % 10>, Group<K / 10>>;
+
+template <typename Is>
+struct WideArchetypes;
+
+template <size_t... Ks>
+struct WideArchetypes<std::index_sequence<Ks...>>
+{
+    using Type = Data<Wide<Ks>...>;
+};
+
+// Built-in events are left out, they are measured by the bouncing balls, and
+// observing them on this many archetypes doubles the compile time.
+using WideRegistry = Registry
+<
+    typename WideArchetypes<std::make_index_sequence<WIDE_COUNT>>::Type, 
+    Data<>, 
+    Data<>, 
+    Data<>, 
+    ObserveNone
+>;
+
+// Creates an entity in a wide archetype chosen at runtime.
+using Spawner = EntityId (*)(WideRegistry&);
+
+template <size_t... Ks>
+constexpr auto make_spawners(std::index_sequence<Ks...>) -> std::array<Spawner, sizeof...(Ks)>
+{
+    return {+[](WideRegistry& r) { return r.create(Wide<Ks>{}); }...};
+}
+
+constexpr auto spawners = make_spawners(std::make_index_sequence<WIDE_COUNT>());
+
+// BOUNCING BALLS
+
+const float WINDOW_W = 800;
+const float WINDOW_H = 800;
+const float BALL_SPEED = 300;
+const float FRAME_TIME = 1.0f / 60.0f;
+
+struct Color { unsigned char r, g, b, a; };
+struct Position { float x; float y; };
+struct Direction { float x; float y; };
+
+using Ball = Data<Color, Position, Direction>;
+
+struct SpawnBalls
+{
+    int amount;
+    Position bounds_max;
+    Position bounds_min;
+};
+
+using DrawQuery = Query<Position, Color>;
+using MoveQuery = Query<Position, Direction>;
+
+using BallRegistry = Registry<Data<Ball>, Data<SpawnBalls>, Data<>, Data<DrawQuery, MoveQuery>>;
+
+// SETTINGS
+
+int entity_count = 0;
+int frame_count = 300;
+std::string json;
+
+std::mt19937 rng(42);
+
+// Frame times and memory of one scenario.
+struct Result
+{
+    std::string name;
+    int frames;
+    double mean;
+    double median;
+    double p95;
+    double p99;
+    double max;
+    size_t peak_memory;
+    size_t entities; // Living and sleeping after the last frame.
+};
+
+std::vector<Result> results;
+
+double percentile(const std::vector<double>& sorted, double p)
+{
+    size_t rank = static_cast<size_t>(std::ceil(p * sorted.size()));
+    return sorted[std::clamp<size_t>(rank, 1, sorted.size()) - 1];
+}
+
+/**
+ * Runs a frame function frame_count times. Only the frames are timed, the
+ * registry's memory is sampled between them.
+ */
+template <typename R, typename F>
+void run_frames(std::string name, R& registry, F frame)
+{
+    std::vector<double> times;
+    MemoryReport report;
+    size_t peak_memory = 0;
+
+    for (int i = 0; i < frame_count; i++)
+    {
+        auto start = std::chrono::steady_clock::now();
+        frame();
+        auto stop = std::chrono::steady_clock::now();
+
+        times.push_back(static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(stop - start).count()));
+
+        registry.memory_report(report);
+        peak_memory = std::max(peak_memory, report.total());
+    }
+
+    std::sort(times.begin(), times.end());
+
+    double mean = 0;
+    for (double t : times) mean += t;
+    mean /= times.size();
+
+    Result r =
+    {
+        name, frame_count, mean, percentile(times, 0.5), percentile(times, 0.95), percentile(times, 0.99),
+        times.back(), peak_memory, report.slots - report.reusable_slots
+    };
+
+    results.push_back(r);
+
+    std::cout
+    << "\n------------------------------------------------"
+    << "\n" << name << ":"
+    << "\n - Frame mean: " << static_cast<long long>(r.mean) << "ns"
+    << "\n - Frame median: " << static_cast<long long>(r.median) << "ns"
+    << "\n - Frame p95: " << static_cast<long long>(r.p95) << "ns"
+    << "\n - Frame p99: " << static_cast<long long>(r.p99) << "ns"
+    << "\n - Frame max: " << static_cast<long long>(r.max) << "ns"
+    << "\n - Peak memory: " << r.peak_memory << "B"
+    << "\n - Frames: " << r.frames
+    << "\n - Entities: " << r.entities
+    << "\n------------------------------------------------";
+}
+
+// Fills a wide registry evenly across its archetypes.
+void populate_wide(WideRegistry& registry, std::vector<EntityId>& ids)
+{
+    for (int i = 0; i < entity_count; i++)
+    {
+        ids.push_back(spawners[i % WIDE_COUNT](registry));
+    }
+}
+
+// Queries that touch every archetype, a tenth of them and a single one.
+void query_wide(WideRegistry& registry)
+{
+    registry.query<Shared>().for_each([](Extraction<Shared> e)
+    {
+        std::get<0>(e.second).value += 1;
+    });
+
+    registry.query<Shared, Layer<3>>().for_each([](Extraction<Shared, Layer<3>> e)
+    {
+        auto& [shared, layer] = e.second;
+        layer.value += shared.value;
+    });
+
+    registry.query<Layer<3>, Group<5>>().for_each([](Extraction<Layer<3>, Group<5>> e)
+    {
+        auto& [layer, group] = e.second;
+        group.value += static_cast<int>(layer.value);
+    });
+}
+
+// Removes a random id from a list by swapping it with the last one.
+auto take_random(std::vector<EntityId>& ids) -> EntityId
+{
+    size_t i = std::uniform_int_distribution<size_t>(0, ids.size() - 1)(rng);
+    EntityId id = ids[i];
+    ids[i] = ids.back();
+    ids.pop_back();
+    return id;
+}
+
+void stress_archetypes()
+{
+    WideRegistry registry;
+    std::vector<EntityId> ids;
+    populate_wide(registry, ids);
+
+    run_frames("Query " + std::to_string(WIDE_COUNT) + " archetypes", registry, [&registry]()
+    {
+        query_wide(registry);
+        registry.update();
+    });
+}
+
+void stress_churn()
+{
+    WideRegistry registry;
+    std::vector<EntityId> ids;
+    populate_wide(registry, ids);
+
+    // Replaces a tenth of the world every frame.
+    size_t churn = std::max<size_t>(1, ids.size() / 10);
+
+    run_frames("Churn 10% per frame", registry, [&registry, &ids, churn]()
+    {
+        for (size_t i = 0; i < churn && !ids.empty(); i++)
+        {
+            registry.queue(take_random(ids), KILL);
+        }
+
+        for (size_t i = 0; i < churn; i++)
+        {
+            size_t archetype = std::uniform_int_distribution<size_t>(0, WIDE_COUNT - 1)(rng);
+            ids.push_back(spawners[archetype](registry));
+        }
+
+        query_wide(registry);
+        registry.update();
+    });
+}
+
+void stress_sleep()
+{
+    WideRegistry registry;
+    std::vector<EntityId> awake;
+    std::vector<EntityId> asleep;
+    populate_wide(registry, awake);
+
+    // Moves a tenth of the world each way every frame, about half ends up sleeping.
+    size_t swaps = std::max<size_t>(1, awake.size() / 10);
+
+    std::vector<EntityId> woken;
+
+    run_frames("Snooze & wake 10% per frame", registry, [&registry, &awake, &asleep, &woken, swaps]()
+    {
+        for (size_t i = 0; i < swaps && !asleep.empty(); i++)
+        {
+            EntityId id = take_random(asleep);
+            registry.queue(id, WAKE);
+            woken.push_back(id);
+        }
+
+        // Only entities untouched this frame are snoozed, a woken one would ignore the task.
+        for (size_t i = 0; i < swaps && awake.size() > 1; i++)
+        {
+            EntityId id = take_random(awake);
+            registry.queue(id, SNOOZE);
+            asleep.push_back(id);
+        }
+
+        awake.insert(awake.end(), woken.begin(), woken.end());
+        woken.clear();
+
+        query_wide(registry);
+        registry.update();
+    });
+}
+
+void stress_balls()
+{
+    BallRegistry registry;
+    auto random = [](float min, float max) { return std::uniform_real_distribution<float>(min, max)(rng); };
+
+    registry.subscribe<SpawnBalls>([&registry, &random](SpawnBalls event)
+    {
+        auto [amount, bounds_max, bounds_min] = event;
+
+        for (int i = 0; i < amount; i++)
+        {
+            Color col =
+            {
+                static_cast<unsigned char>(random(0, 255)),
+                static_cast<unsigned char>(random(0, 255)),
+                static_cast<unsigned char>(random(0, 255)),
+                255
+            };
+            Position pos = {random(bounds_min.x, bounds_max.x), random(bounds_min.y, bounds_max.y)};
+            Direction dir = {random(-100, 100), random(-100, 100)};
+
+            float mag = std::sqrt(dir.x * dir.x + dir.y * dir.y);
+
+            if (mag != 0)
+            {
+                dir.x /= mag;
+                dir.y /= mag;
+            }
+
+            registry.create(Ball{col, pos, dir});
+        }
+    });
+
+    registry.call(SpawnBalls{entity_count, {WINDOW_W, WINDOW_H}, {0, 0}});
+
+    // Stands in for drawing, a renderer would consume it.
+    std::vector<std::pair<Position, Color>> draw_list;
+
+    run_frames("Bouncing balls", registry, [&registry, &draw_list]()
+    {
+        // A few clicks worth of balls every frame.
+        registry.call(SpawnBalls{3, {WINDOW_W / 2 + 5, WINDOW_H / 2 + 5}, {WINDOW_W / 2, WINDOW_H / 2}});
+
+        registry.query<MoveQuery>().for_each([](Extraction<Position, Direction> e)
+        {
+            auto& [pos, dir] = e.second;
+
+            pos.x += dir.x * BALL_SPEED * FRAME_TIME;
+            pos.y += dir.y * BALL_SPEED * FRAME_TIME;
+
+            if (pos.x > WINDOW_W || pos.x < 0) dir.x = -dir.x;
+            if (pos.y > WINDOW_H || pos.y < 0) dir.y = -dir.y;
+        });
+
+        draw_list.clear();
+
+        registry.query<DrawQuery>().for_each([&draw_list](Extraction<Position, Color> e)
+        {
+            auto& [pos, col] = e.second;
+            draw_list.emplace_back(pos, col);
+        });
+
+        registry.update();
+    });
+}
+
+void write_json()
+{
+    std::ofstream out(json);
+
+    out << "{\n  \"entities\": " << entity_count << ",\n  \"scenarios\": [";
+
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        const Result& r = results[i];
+
+        out << (i ? ",\n" : "\n")
+        << "    {\"name\": \"" << r.name << "\", \"frames\": " << r.frames << ", \"mean_ns\": " << r.mean
+        << ", \"median_ns\": " << r.median << ", \"p95_ns\": " << r.p95 << ", \"p99_ns\": " << r.p99
+        << ", \"max_ns\": " << r.max << ", \"peak_memory_bytes\": " << r.peak_memory
+        << ", \"final_entities\": " << r.entities << "}";
+    }
+
+    out << "\n  ],\n  \"peak_rss_bytes\": " << peak_rss() << "\n}\n";
+}
+
+void usage()
+{
+    std::cerr
+    << "Usage: stress <entities> [options]\n"
+    << "  --frames <n>   frames per scenario (300)\n"
+    << "  --json <file>  write results as JSON\n";
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 2) {
+        usage();
+        return 1;
+    }
+
+    entity_count = std::stoi(argv[1]);
+
+    for (int i = 2; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+
+        if (arg == "--frames" && has_value) frame_count = std::max(1, std::stoi(argv[++i]));
+        else if (arg == "--json" && has_value) json = argv[++i];
+        else
+        {
+            usage();
+            return 1;
+        }
+    }
+
+    std::cout << "\n=== Running stress benchmarks for: " << entity_count << " entities ===";
+
+    stress_archetypes();
+    stress_churn();
+    stress_sleep();
+    stress_balls();
+
+    std::cout
+    << "\n------------------------------------------------"
+    << "\nPeak RSS: " << peak_rss() << "B"
+    << "\n------------------------------------------------";
+
+    if (!json.empty()) write_json();
+
+    std::cout << "\n=== Stress benchmarks succeeded ===\n";
+
+    return 0;
+}
@@ -120,8 +120,8 @@ void manage()
 
 void check()
 {
-    // read-only location info reference for entity with id 0
-    auto& [type, index, state, id_lock] = registry.info(0);
+    // copy of the metadata of the entity with id 0
+    auto [archetype, index, state, generation] = registry.info(0);
 
     // are there any entities of this archetype in living
     registry.is_empty<Monster>();
@@ -135,8 +135,8 @@ void check()
     // is the entity with id 0 dead
     registry.is_state(0, DEAD);
 
-    // can the entity's id be reused on death
-    registry.is_locked(0);
+    // is the handle current and the entity not dead
+    registry.is_alive(0);
 
     // does the entity have a name component
     registry.has_component<Name>(0);
@@ -1,3 +1,6 @@
+#include <cstdio>
+#include <sstream>
+
 #include "../model.hpp"
 
 Registry<Archetypes, Events, Singletons> reg;
@@ -6,14 +9,14 @@ void test_subscribe()
 {
     reg.subscribe<EntityCreated>
     ([](EntityCreated event){
-        auto& info = reg.info(event.id);
+        EntityInfo info = reg.info(event.id);
 
         std::cout << "\n------------------------------------------------\n";
         std::cout << "Created entity:" 
         << "\n Id: " << event.id 
-        << "\n Type: " << info.type.name()
+        << "\n Archetype: " << info.archetype
         << "\n Index: " << info.index
-        << "\n State: " << info.state;
+        << "\n State: " << static_cast<int>(info.state);
 
         if (info.state != LIVE)
         {
@@ -54,7 +57,7 @@ void test_create()
 {
     EntityId id = reg.create(A3(Health{10}, Position{1, 4}, Name{"First"}));
 
-    auto& info = reg.info(id);
+    EntityInfo info = reg.info(id);
 
     if (info.index != 0)
     {
@@ -100,9 +103,35 @@ void test_query()
     };
 }
 
-void test_id_locking()
+void test_generations()
 {
+    EntityId first = reg.create(A1(Health{1}));
+
+    reg.execute(first, KILL);
+
+    if (reg.is_alive(first) || !reg.is_state(first, DEAD))
+    {
+        throw std::runtime_error("Killed entity is still alive.");
+    }
+
+    EntityId second = reg.create(A1(Health{2}));
+
+    if (id_slot(second) != id_slot(first) || second == first)
+    {
+        throw std::runtime_error("Dead slot was not recycled with a new generation.");
+    }
+
+    if (reg.view<A1, Health>(first).has_value() || reg.find<Health>(first).has_value())
+    {
+        throw std::runtime_error("Stale handle was not rejected.");
+    }
 
+    reg.execute(first, KILL);
+
+    if (!reg.is_alive(second) || std::get<0>(reg.get<A1, Health>(second)).value != 2)
+    {
+        throw std::runtime_error("Stale handle affected the slot's new entity.");
+    }
 }
 
 void test_populate()
@@ -115,6 +144,1500 @@ void test_has_component()
     bool v = reg.has_component<Name>(0);
 
     std::cout << "\nEntity 0 has Name: " << v << "\n";
+
+    EntityId id = reg.create(A1(Health{1}));
+
+    if (reg.has_component<Name>(id) || !reg.has_component<Health>(id))
+    {
+        throw std::runtime_error("Incorrect component check for A1.");
+    }
+
+    using Sigs = Signatures<Archetypes>;
+    static_assert(Sigs::archetypes[2].contains(Sigs::of<Health, const Name>), "A3 signature is missing components.");
+    static_assert(!Sigs::archetypes[0].intersects(Sigs::of<Position, Name>), "A1 signature has foreign components.");
+    static_assert(std::is_same_v<Sigs::Match<Data<Health>, Data<Name>>, std::index_sequence<0, 1>>, "Incorrect with/without match.");
+    static_assert(std::is_same_v<Sigs::Match<Data<S1>, Data<>>, std::index_sequence<>>, "Unknown component matched.");
+
+    auto with = reg.signature<Health>();
+    auto without = reg.signature<Position, S1>();
+
+    if (!reg.matches(id, with, without) || reg.matches(id, without) || reg.signature(id) != Sigs::archetypes[0])
+    {
+        throw std::runtime_error("Incorrect runtime signature match for A1.");
+    }
+}
+
+void test_par_for_each()
+{
+    reg.populate(A2(Health{1}, Position{0, 0}), 10000);
+
+    long long before = 0;
+    size_t count = 0;
+
+    reg.query<Health>().for_each([&before, &count](Extraction<Health> e)
+    {
+        before += std::get<0>(e.second).value;
+        count++;
+    });
+
+    reg.query<Health>().par_for_each(reg.workers(), [](Extraction<Health> e)
+    {
+        std::get<0>(e.second).value++;
+    });
+
+    long long after = 0;
+
+    reg.query<Health>().for_each([&after](Extraction<Health> e)
+    {
+        after += std::get<0>(e.second).value;
+    });
+
+    if (after != before + static_cast<long long>(count))
+    {
+        throw std::runtime_error("Parallel for_each did not visit every entity exactly once.");
+    }
+
+    // Slices span whole cache lines, which only keeps them apart if columns start on one.
+    if (reinterpret_cast<uintptr_t>(&reg.vector<A2, Health>()[0]) % CACHE_LINE != 0)
+    {
+        throw std::runtime_error("Column blocks are not aligned to a cache line.");
+    }
+
+    // A throwing callback reaches the caller after the whole batch is done, and the pool stays usable.
+    ThreadPool pool(4);
+    std::atomic<size_t> ran = 0;
+    bool thrown = false;
+
+    try
+    {
+        pool.run(64, [&ran](size_t i)
+        {
+            ran++;
+            if (i % 8 == 0) throw std::logic_error("task");
+        });
+    }
+    catch (const std::logic_error&)
+    {
+        thrown = true;
+    }
+
+    if (!thrown || ran != 64)
+    {
+        throw std::runtime_error("Thread pool did not propagate a task exception after the batch.");
+    }
+
+    std::cout << "\nParallel for_each visited " << count << " entities\n";
+}
+
+void test_each_chunk()
+{
+    size_t count = 0;
+    size_t expected = 0;
+
+    reg.query<Health, Position>().for_each([&expected](Extraction<Health, Position>) { expected++; });
+
+    reg.query<Health, Position>().each_chunk([&count](std::span<const EntityId> ids, std::span<Health> health, std::span<Position> pos)
+    {
+        if (ids.size() != health.size() || ids.size() != pos.size())
+        {
+            throw std::runtime_error("Chunk spans differ in size.");
+        }
+
+        for (size_t i = 0; i < health.size(); i++)
+        {
+            health[i].value++;
+            pos[i].x += 1;
+        }
+
+        count += ids.size();
+    });
+
+    if (count != expected || expected == 0)
+    {
+        throw std::runtime_error("Each chunk skipped entities.");
+    }
+
+    auto [health] = reg.query_in<A3, Health>().columns();
+
+    if (health.size() != reg.pool_count<A3>())
+    {
+        throw std::runtime_error("Iterator columns do not cover the pool.");
+    }
+}
+
+void test_populate_batch()
+{
+    size_t created = 0;
+
+    Subscription subscription = reg.subscribe<EntitiesCreated>([&created](EntitiesCreated event)
+    {
+        created += event.ids.size();
+    });
+
+    std::vector<EntityId> prefabs = reg.populate(A3(Health{7}, Position{1, 2}, Name{"Prefab"}), 100);
+
+    std::vector<A2> range(50, A2(Health{3}, Position{0, 0}));
+    std::vector<EntityId> ranged = reg.populate(range);
+
+    std::vector<EntityId> generated = reg.populate<A1>(25, [](size_t i) { return A1(Health{static_cast<int>(i)}); });
+
+    if (created != 175 || prefabs.size() != 100 || ranged.size() != 50 || generated.size() != 25)
+    {
+        throw std::runtime_error("Batch creation did not fire one event per batch.");
+    }
+
+    for (EntityId id : prefabs)
+    {
+        auto [health, name] = reg.get<A3, Health, Name>(id);
+
+        if (health.value != 7 || name.value != "Prefab")
+        {
+            throw std::runtime_error("Prefab batch has incorrect data.");
+        }
+    }
+
+    if (std::get<0>(reg.get<A2, Health>(ranged.back())).value != 3)
+    {
+        throw std::runtime_error("Range batch has incorrect data.");
+    }
+
+    for (size_t i = 0; i < generated.size(); i++)
+    {
+        if (std::get<0>(reg.get<A1, Health>(generated[i])).value != static_cast<int>(i))
+        {
+            throw std::runtime_error("Generated batch has incorrect data.");
+        }
+    }
+
+    for (size_t i = 0; i < 10; i++)
+    {
+        reg.execute(prefabs[i], KILL);
+    }
+
+    // The dead slots are taken first, only the rest of the batch needs new ones.
+    size_t slots = reg.total();
+    std::vector<EntityId> refill = reg.populate(A3(Health{9}, Position{0, 0}, Name{"Refill"}), 20);
+
+    if (reg.total() != slots + 10 || reg.is_alive(prefabs[0]))
+    {
+        throw std::runtime_error("Batch did not reuse dead slots.");
+    }
+
+    for (EntityId id : refill)
+    {
+        if (std::get<0>(reg.get<A3, Name>(id)).value != "Refill")
+        {
+            throw std::runtime_error("Batch did not overwrite dead slots correctly.");
+        }
+    }
+
+    reg.unsubscribe<EntitiesCreated>(subscription);
+
+    // Populating and killing in a loop recycles the same slots, past the slot count of 32-bit ids.
+    Registry<Archetypes, Events, Singletons> churn;
+
+    for (int round = 0; round < 100; round++)
+    {
+        for (EntityId id : churn.populate(A1(Health{round}), 20000)) churn.queue(id, KILL);
+        churn.update();
+    }
+
+    if (churn.total() != 20000 || churn.state_total(DEAD) != 20000)
+    {
+        throw std::runtime_error("Populate did not reuse dead slots.");
+    }
+
+    // A batch that throws halfway leaves neither metadata nor components behind.
+    Registry<Archetypes, Events, Singletons> local;
+    local.populate(A2(Health{1}, Position{}), 10);
+
+    try 
+    {
+        local.populate<A2>(20, [](size_t i) 
+        { 
+            if (i == 15) throw std::runtime_error("Generator failed.");
+            return A2(Health{2}, Position{});
+        });
+
+        throw std::logic_error("Populate swallowed a throwing generator.");
+    }
+    catch (const std::runtime_error&) {}
+
+    if (local.pool_count<A2>() != 10 || local.state_total(LIVE) != 10 || local.state_total(DEAD) != 20)
+    {
+        throw std::runtime_error("Failed batch left entities behind.");
+    }
+
+    // The metadata still matches the pools, which loading a snapshot of it checks.
+    std::stringstream snapshot;
+    local.save(snapshot);
+    local.load(snapshot);
+
+    local.populate(A2(Health{3}, Position{}), 5);
+
+    if (local.pool_count<A2>() != 15 || local.state_total(LIVE) != 15)
+    {
+        throw std::runtime_error("Populating after a failed batch did not work.");
+    }
+}
+
+void test_move_and_emplace()
+{
+    std::string long_name(64, 'x');
+
+    EntityId emplaced = reg.emplace<A3>(Health{5}, Position{1, 1}, Name{long_name});
+
+    A3 entity(Health{6}, Position{2, 2}, Name{long_name});
+    EntityId moved = reg.create(std::move(entity));
+
+    if (!std::get<Name>(entity).value.empty())
+    {
+        throw std::runtime_error("Create did not move the entity's components.");
+    }
+
+    reg.execute(emplaced, SNOOZE);
+    reg.execute(moved, SNOOZE);
+    reg.execute(emplaced, WAKE);
+
+    auto [name, health] = reg.get<A3, Name, Health>(emplaced);
+    auto [moved_name] = reg.get<A3, Name>(moved);
+
+    if (name.value != long_name || health.value != 5 || moved_name.value != long_name || !reg.is_state(moved, SLEEPING))
+    {
+        throw std::runtime_error("Relocation between pools lost component data.");
+    }
+
+    reg.execute(moved, WAKE);
+}
+
+void test_batched_update()
+{
+    for (int mode = 0; mode < 3; mode++)
+    {
+        bool preserve_order = mode == 1;
+        bool parallel = mode == 2;
+
+        Registry<Archetypes, Events, Singletons> local;
+
+        const int count = 2000;
+
+        std::vector<EntityId> ids = local.populate<A2>(count, [](size_t i) { return A2(Health{static_cast<int>(i)}, Position{0, 0}); });
+        local.populate<A3>(count, [](size_t i) { return A3(Health{static_cast<int>(i)}, Position{0, 0}, Name{"A3"}); });
+
+        uint32_t seed = 7;
+
+        for (int frame = 0; frame < 20; frame++)
+        {
+            for (EntityId id : ids)
+            {
+                seed = seed * 1664525 + 1013904223;
+
+                switch ((seed >> 16) % 16)
+                {
+                    case 0: local.queue(id, KILL); break;
+                    case 1: case 2: local.queue(id, SNOOZE); break;
+                    case 3: case 4: local.queue(id, WAKE); break;
+                    default: break;
+                }
+            }
+
+            std::vector<EntityId> before(local.ids<A2>().begin(), local.ids<A2>().begin() + local.pool_count<A2>());
+
+            local.update(preserve_order, parallel);
+
+            size_t alive = 0;
+
+            for (int i = 0; i < count; i++)
+            {
+                if (!local.is_alive(ids[i])) continue;
+
+                alive++;
+
+                if (std::get<0>(local.get<A2, Health>(ids[i])).value != i)
+                {
+                    throw std::runtime_error("Batched update lost track of an entity.");
+                }
+            }
+
+            if (alive != local.pool_count<A2>() + local.pool_count<A2>(true))
+            {
+                throw std::runtime_error("Batched update left pools and metadata out of sync.");
+            }
+
+            if (preserve_order)
+            {
+                size_t next = 0;
+
+                for (EntityId id : before)
+                {
+                    if (!local.is_state(id, LIVE)) continue;
+
+                    if (local.ids<A2>()[next++] != id)
+                    {
+                        throw std::runtime_error("Order-preserving update reordered the living pool.");
+                    }
+                }
+            }
+        }
+    }
+}
+
+void test_command_buffers()
+{
+    Registry<Archetypes, Events, Singletons> local;
+
+    std::vector<EntityId> ids = local.populate<A2>(5000, [](size_t i) { return A2(Health{static_cast<int>(i)}, Position{0, 0}); });
+
+    local.query<Health, Position>().par_for_each(local.workers(), [&local](Extraction<Health, Position> e)
+    {
+        auto& [id, data] = e;
+        auto& [health, pos] = data;
+
+        auto& commands = local.commands();
+
+        if (health.value % 2 == 0)
+        {
+            commands.kill(id);
+        }
+        else 
+        {
+            commands.set(id, Health{-health.value});
+        }
+
+        if (health.value % 100 == 0)
+        {
+            commands.create(A1(Health{1000}));
+        }
+    });
+
+    if (local.state_total(LIVE) != 5000)
+    {
+        throw std::runtime_error("Commands were applied before flush.");
+    }
+
+    local.flush();
+
+    for (int i = 0; i < 5000; i++)
+    {
+        EntityId id = ids[i];
+
+        if (local.is_alive(id) == (i % 2 == 0))
+        {
+            throw std::runtime_error("Deferred kill was not applied correctly.");
+        }
+
+        if (i % 2 == 1 && std::get<0>(local.get<A2, Health>(id)).value != -i)
+        {
+            throw std::runtime_error("Deferred component write was not applied.");
+        }
+    }
+
+    if (local.pool_count<A1>() != 50 || local.pool_count<A2>() != 2500)
+    {
+        throw std::runtime_error("Deferred creation was not applied.");
+    }
+
+    // Threads of another pool get buffers of their own.
+    ThreadPool foreign(4);
+
+    local.query<const Health>().par_for_each(foreign, [&local](Extraction<const Health> e)
+    {
+        local.commands().set(e.first, Health{7});
+        local.commands().create(A1(Health{7}));
+    });
+
+    local.flush();
+
+    if (local.pool_count<A1>() != 2600 || local.memory_report().command_bytes == 0)
+    {
+        throw std::runtime_error("Commands recorded on another pool were lost.");
+    }
+
+    for (auto [id, data] : local.query<const Health>())
+    {
+        if (std::get<0>(data).value != 7) throw std::runtime_error("Commands recorded on another pool were not applied.");
+    }
+}
+
+void test_command_order()
+{
+    using Local = Registry<Archetypes, Events, Singletons>;
+
+    // Records conflicting commands from parallel loops and systems, returns what they left behind.
+    auto record = [](size_t threads)
+    {
+        Local local;
+        local.set_workers(threads);
+
+        std::vector<EntityId> ids = local.populate<A2>(3000, [](size_t i) { return A2(Health{static_cast<int>(i)}, Position{static_cast<float>(i), 0}); });
+        EntityId first = ids[0];
+        EntityId target = ids[1];
+
+        local.query<Health, const Position>().par_for_each(local.workers(), [&local, target](Extraction<Health, const Position> e)
+        {
+            auto [health, position] = e.second;
+            auto& commands = local.commands();
+
+            if (health.value % 7 == 0) commands.create(A1(Health{health.value}));
+            if (health.value % 5 == 0) commands.set(target, Health{health.value});
+
+            commands.set(e.first, Position{position.x, static_cast<float>(static_cast<int>(position.x) % 3)});
+        });
+
+        Scheduler<Local> scheduler(local);
+
+        for (int system = 0; system < 8; system++)
+        {
+            scheduler.add<const Name>("create", [&local, first, system, run = 0](Query<const Name>&) mutable
+            {
+                for (int i = 0; i < 10; i++) local.commands().create(A1(Health{-(run * 1000 + system * 10 + i)}));
+                local.commands().set(first, Position{static_cast<float>(system), static_cast<float>(run)});
+                run++;
+            });
+        }
+
+        local.flush();
+
+        // Repeated runs between flushes must not share keys.
+        scheduler.run();
+        scheduler.run();
+        local.flush();
+
+        std::vector<long long> state;
+
+        for (auto [id, data] : local.query<const Health>()) state.insert(state.end(), {static_cast<long long>(id), std::get<0>(data).value});
+        for (auto [id, data] : local.query<const Position>()) state.push_back(static_cast<long long>(std::get<0>(data).y));
+
+        return state;
+    };
+
+    // Keys never repeat across scheduler runs and parallel loops between two flushes.
+    Local single;
+    single.set_workers(0);
+    EntityId id = single.create(A1(Health{0}));
+
+    Scheduler<Local> scheduler(single);
+    scheduler.add<const Name>("a", [&single, id](Query<const Name>&) { single.commands().set(id, Health{1}); });
+    scheduler.add<const Name>("b", [&single, id](Query<const Name>&) { single.commands().set(id, Health{2}); });
+
+    for (int run = 0; run < 2; run++)
+    {
+        scheduler.run();
+        single.query<const Health>().par_for_each(single.workers(), [&single](Extraction<const Health> e) { single.commands().set(e.first, Health{3}); });
+    }
+
+    std::vector<CommandKey> keys;
+    for (auto& [key, write] : single.commands().writes<Health>()) keys.push_back(key);
+    std::ranges::sort(keys);
+
+    if (keys.size() != 6 || std::ranges::adjacent_find(keys) != keys.end())
+    {
+        throw std::runtime_error("Commands recorded between two flushes share a key.");
+    }
+
+    std::vector<long long> expected = record(0);
+
+    for (size_t threads : {1, 2, 4, 8})
+    {
+        if (record(threads) != expected)
+        {
+            throw std::runtime_error("Flushed commands depend on the number of threads.");
+        }
+    }
+}
+
+void test_command_churn()
+{
+    Registry<Archetypes, Events, Singletons> local;
+
+    // Entities created through commands take the slots of the ones killed before them.
+    for (int frame = 0; frame < 200; frame++)
+    {
+        for (auto [id, data] : local.query<const Health>()) local.commands().kill(id);
+        for (int i = 0; i < 100; i++) local.commands().create(A1(Health{frame}));
+
+        local.flush();
+    }
+
+    MemoryReport report = local.memory_report();
+
+    if (local.pool_count<A1>() != 100 || report.slots > 200)
+    {
+        throw std::runtime_error("Deferred creation did not reuse dead slots.");
+    }
+}
+
+void test_memory_resources()
+{
+    // Resources must outlive the registry that uses them.
+    std::pmr::unsynchronized_pool_resource arena;
+    HugePageResource huge(1 << 16);
+
+    Registry<Archetypes, Events, Singletons> local;
+
+    local.reserve<A2>(1000);
+
+    if (local.vector<A2, Health>().capacity() < 1000 || local.ids<A2>().capacity() < 1000)
+    {
+        throw std::runtime_error("Reserve did not size the pool's columns.");
+    }
+
+    EntityId first = local.populate(A2(Health{3}, Position{1, 2}), 1000).front();
+    const Health* before = &local.vector<A2, Health>()[0];
+    local.populate(A2{}, 0);
+
+    if (&local.vector<A2, Health>()[0] != before)
+    {
+        throw std::runtime_error("Populating a reserved pool reallocated its columns.");
+    }
+
+    local.set_resource<A3>(&arena);
+    EntityId named = local.create(A3(Health{1}, Position{}, Name{std::string(64, 'n')}));
+
+    local.set_resource<A2>(&huge);
+    local.populate(A2(Health{4}, Position{}), 10000);
+
+    if (local.vector<A2, Health>().resource() != &huge || std::get<0>(local.get<A2, Health>(first)).value != 3)
+    {
+        throw std::runtime_error("Setting a resource lost the pool's data.");
+    }
+
+    if (local.pool_count<A2>() != 11000 || std::get<0>(local.get<A3, Name>(named)).value.size() != 64)
+    {
+        throw std::runtime_error("Pools with custom resources hold the wrong entities.");
+    }
+
+    // Archetypes sharing the arena are updated one after the other, even in parallel updates.
+    local.set_resource<A1>(&arena);
+    local.populate(A1(Health{5}), 1000);
+
+    for (auto [id, data] : local.query<const Health>()) local.queue(id, SNOOZE);
+
+    local.update(false, true);
+
+    if (local.pool_count<A1>(true) != 1000 || local.pool_count<A2>(true) != 11000 || local.pool_count<A3>(true) != 1)
+    {
+        throw std::runtime_error("Parallel update over unsynchronized resources lost entities.");
+    }
+
+    // Change ticks follow the pool's resource too.
+    Pool<A2> pool;
+    pool.set_resource(&arena);
+
+    if (pool.ticks<Health>().resource() != &arena || pool.ticks<Added>().resource() != &arena)
+    {
+        throw std::runtime_error("Change ticks ignored the pool's resource.");
+    }
+}
+
+void test_cached_queries()
+{
+    using Moving = Query<Health, Position>;
+    Registry<Archetypes, Events, Singletons, Data<Moving>> local;
+
+    std::vector<EntityId> moving = local.populate(A2(Health{1}, Position{}), 10);
+    local.populate(A3(Health{1}, Position{}, Name{}), 5);
+
+    size_t outer = 0;
+    size_t inner = 0;
+
+    for (auto e : local.query<Moving>())
+    {
+        (void)e;
+        outer++;
+
+        // Queries are views over a shared table, nesting keeps separate cursors.
+        for (auto e : local.query<Health, Position>())
+        {
+            (void)e;
+            inner++;
+        }
+    }
+
+    if (outer != 15 || inner != 15 * 15)
+    {
+        throw std::runtime_error("Cached query visited the wrong number of entities.");
+    }
+
+    for (EntityId id : moving)
+    {
+        local.queue(id, SNOOZE);
+    }
+
+    local.update();
+
+    size_t awake = 0;
+    size_t asleep = 0;
+
+    local.query<Moving>().for_each([&awake](Extraction<Health, Position>) { awake++; });
+    local.query<Moving>(true).for_each([&asleep](Extraction<Health, Position>) { asleep++; });
+
+    Query<Health, Position> living = local.query<Health, Position>();
+
+    if (awake != 5 || asleep != 10 || living.is_occupied(0) || !living.is_occupied(1))
+    {
+        throw std::runtime_error("Query did not skip pools emptied by an update.");
+    }
+}
+
+// Stored in blocks of 4 entities, small enough to cross many block boundaries.
+using Blocky = Data<Position, Health>;
+
+template <>
+struct NECS::BlockSize<Blocky> : std::integral_constant<size_t, 4> {};
+
+void test_chunked_storage()
+{
+    std::pmr::unsynchronized_pool_resource arena;
+    Registry<Data<A1, Blocky>, Events, Singletons> local;
+    local.set_workers(2);
+
+    EntityId first = local.create(Blocky(Position{1, 1}, Health{1}));
+    Health* address = &std::get<0>(local.get<Blocky, Health>(first));
+
+    std::vector<EntityId> blocky = local.populate(Blocky(Position{}, Health{2}), 100);
+
+    if (&std::get<0>(local.get<Blocky, Health>(first)) != address)
+    {
+        throw std::runtime_error("Chunked pool moved a component while growing.");
+    }
+
+    // Removing an entity only moves the pool's last entity, into the freed slot.
+    EntityId removed = blocky[49];
+    EntityId last = local.ids<Blocky>()[local.pool_count<Blocky>() - 1];
+    Health* freed = &std::get<0>(local.get<Blocky, Health>(removed));
+    std::get<0>(local.get<Blocky, Health>(last)).value = 3;
+
+    local.execute(removed, KILL);
+
+    if (&std::get<0>(local.get<Blocky, Health>(first)) != address || address->value != 1)
+    {
+        throw std::runtime_error("Removing an entity moved an unrelated component.");
+    }
+
+    if (&std::get<0>(local.get<Blocky, Health>(last)) != freed || freed->value != 3)
+    {
+        throw std::runtime_error("Removing an entity did not move the last entity into its slot.");
+    }
+
+    std::get<0>(local.get<Blocky, Health>(last)).value = 2;
+    local.create(Blocky(Position{}, Health{2}));
+
+    for (size_t i = 0; i < blocky.size(); i += 3)
+    {
+        local.queue(blocky[i], KILL);
+    }
+
+    local.update();
+
+    size_t count = 0;
+    size_t chunks = 0;
+    int total = 0;
+    std::atomic<int> par_total = 0;
+
+    local.query<Health>().for_each([&count](Extraction<Health>) { count++; });
+
+    local.query<Position, Health>().each_chunk([&chunks, &total](std::span<const EntityId> ids, std::span<Position>, std::span<Health> health)
+    {
+        if (ids.size() > 4 || ids.size() != health.size()) throw std::runtime_error("Chunk is larger than a block.");
+
+        chunks++;
+        for (Health& h : health) total += h.value;
+    });
+
+    local.query<Health>().par_for_each(local.workers(), [&par_total](Extraction<Health> e)
+    {
+        par_total += std::get<0>(e.second).value;
+    });
+
+    if (count != 67 || chunks != 17 || total != 1 + 66 * 2 || par_total != total)
+    {
+        throw std::runtime_error("Chunked pool iterated the wrong entities.");
+    }
+
+    local.trim<Blocky>();
+
+    if (local.vector<Blocky, Health>().capacity() != 68)
+    {
+        throw std::runtime_error("Trimming a chunked pool did not release its empty blocks.");
+    }
+
+    local.set_resource<Blocky>(&arena);
+
+    if (std::get<0>(local.get<Blocky, Health>(first)).value != 1 || local.pool_count<Blocky>() != 67)
+    {
+        throw std::runtime_error("Moving a chunked pool to another resource lost data.");
+    }
+
+    local.reserve<Blocky>(400);
+    local.shrink<Blocky>();
+
+    if (local.capacity<Blocky>() != 68 || std::get<0>(local.get<Blocky, Health>(first)).value != 1)
+    {
+        throw std::runtime_error("Shrinking a chunked pool did not release its reserved blocks.");
+    }
+}
+
+template <typename A>
+void test_iteration_changes(Registry<Data<A1, A2, Blocky>, Events, Singletons>& local)
+{
+    local.populate(A(), 10);
+
+    // Contiguous pools must not reallocate under a loop, chunked ones never do.
+    if constexpr (BlockSize<A>::value == 0) local.template reserve<A>(10 + 3 * 64);
+
+    size_t visited = 0;
+
+    // Entities created while iterating are visited too.
+    for (auto [id, data] : local.template query_in<A, Health>())
+    {
+        if (std::get<0>(data).value != 0) throw std::runtime_error("Iteration read a reallocated column.");
+
+        if (visited++ < 3) 
+        {
+            for (int i = 0; i < 64; i++) local.create(A());
+        }
+    }
+
+    if (visited != 10 + 3 * 64)
+    {
+        throw std::runtime_error("Iteration missed entities created while iterating.");
+    }
+
+    visited = 0;
+
+    // Kills are recorded while iterating and applied once the loop is done.
+    for (auto [id, data] : local.template query_in<A, Health>())
+    {
+        if (visited++ % 2 == 0) local.commands().kill(id);
+    }
+
+    local.flush();
+
+    if (visited != 10 + 3 * 64 || local.template pool_count<A>() != visited / 2)
+    {
+        throw std::runtime_error("Iteration visited the wrong entities while killing.");
+    }
+}
+
+void test_iteration_changes()
+{
+    Registry<Data<A1, A2, Blocky>, Events, Singletons> local;
+
+    test_iteration_changes<A2>(local);
+    test_iteration_changes<Blocky>(local);
+}
+
+void test_change_ticks()
+{
+    Registry<Archetypes, Events, Singletons> local;
+
+    std::vector<EntityId> entities = local.populate(A2(Health{1}, Position{}), 600);
+    Tick since = local.next_tick();
+
+    auto count = [](auto changes)
+    {
+        size_t n = 0;
+        changes.for_each([&n](auto) { n++; });
+        return n;
+    };
+
+    if (count(local.query_changed<Health, Health>(since)) != 0 || count(local.query_added<Health>(0)) != 600)
+    {
+        throw std::runtime_error("New entities should be added but not changed after their tick.");
+    }
+
+    std::get<0>(local.get<A2, Health>(entities[10])).value = 5;
+    auto [position] = local.get<A2, const Position>(entities[20]);
+    local.mark_changed<Position>(entities[300]);
+
+    size_t chunks = 0;
+    local.query_changed<Health, Health>(since).each_chunk([&chunks](std::span<const EntityId> ids, std::span<Health>)
+    {
+        if (ids.size() != 256) throw std::runtime_error("Changed chunk has the wrong size.");
+        chunks++;
+    });
+
+    if (count(local.query_changed<Health, Health>(since)) != 1 || count(local.query_changed<Position, Health>(since)) != 1 || chunks != 1 || position.x != 0)
+    {
+        throw std::runtime_error("Change ticks do not match the accessed components.");
+    }
+
+    local.queue(entities[10], KILL);
+    local.queue(entities[30], SNOOZE);
+    local.update();
+
+    // The last entity was swapped into the killed one's slot and must keep its own tick.
+    if (count(local.query_changed<Health, Health>(since)) != 0 || count(local.query_added<Health>(since, true)) != 1)
+    {
+        throw std::runtime_error("Change ticks were not moved along with their entities.");
+    }
+
+    // Marking dispatches on the archetype: sleeping entities are stamped, stale ids and archetypes without the component are not.
+    EntityId other = local.create(A1(Health{1}));
+    Tick asleep = local.next_tick();
+
+    local.mark_changed<Health>(entities[30]);
+    local.mark_changed<Health>(entities[10]);
+    local.mark_changed<Position>(other);
+    local.mark_changed<Health>(other);
+
+    if (count(local.query_changed<Health, Health>(asleep, true)) != 1 || count(local.query_changed<Health, Health>(asleep)) != 1 || count(local.query_changed<Position, Position>(asleep)) != 0)
+    {
+        throw std::runtime_error("Marking a change stamped the wrong entity.");
+    }
+
+    // Queries stamp their mutable components, filtered queries and const components are never stamped.
+    Tick queried = local.next_tick();
+
+    local.query<const Health, const Position>().for_each([](Extraction<const Health, const Position>) {});
+    local.query_changed<Health, Health, Position>(0).for_each([](Extraction<Health, Position>) {});
+
+    if (count(local.query_changed<Health, Health>(queried)) != 0 || count(local.query_changed<Position, Position>(queried)) != 0)
+    {
+        throw std::runtime_error("Reading through a query stamped changes.");
+    }
+
+    local.query<Health, const Position>().each_chunk([](std::span<const EntityId>, std::span<Health>, std::span<const Position>) {});
+
+    if (count(local.query_changed<Health, Health>(queried)) != 598 || count(local.query_changed<Position, Position>(queried)) != 0)
+    {
+        throw std::runtime_error("each_chunk did not stamp its mutable spans.");
+    }
+
+    local.set_workers(2);
+    queried = local.next_tick();
+
+    local.query<const Health, Position>().par_for_each(local.workers(), [](Extraction<const Health, Position>) {});
+
+    if (count(local.query_changed<Position, Position>(queried)) != 598 || count(local.query_changed<Health, Health>(queried)) != 0)
+    {
+        throw std::runtime_error("par_for_each did not stamp its mutable slices.");
+    }
+
+    // A loop that leaves early only stamps the entities it visited.
+    queried = local.next_tick();
+    size_t visited = 0;
+
+    for (auto [id, data] : local.query_in<A2, Health>())
+    {
+        std::get<0>(data).value = 2;
+        if (++visited == 100) break;
+    }
+
+    if (count(local.query_changed<Health, Health>(queried)) != visited || count(local.query_changed<Position, Position>(queried)) != 0)
+    {
+        throw std::runtime_error("Iterating stamped entities it never visited.");
+    }
+}
+
+void test_event_channels()
+{
+    Registry<Archetypes, Events, Singletons> local;
+
+    size_t immediate = 0, other = 0, batches = 0, batched = 0;
+    int sum = 0;
+
+    local.subscribe<AEvent>([&immediate](AEvent) { immediate++; });
+    Subscription second = local.subscribe<AEvent>([&other](AEvent) { other++; });
+    local.subscribe<AEvent>([&](std::span<const AEvent> events)
+    {
+        batches++;
+        batched += events.size();
+        for (const AEvent& event : events) sum += event.value;
+    });
+
+    for (int i = 1; i <= 10; i++) local.call(AEvent{i});
+
+    if (immediate != 10 || other != 10 || batches != 0)
+    {
+        throw std::runtime_error("Event channel did not call every immediate subscriber or dispatched early.");
+    }
+
+    local.dispatch_events();
+    local.dispatch_events();
+
+    if (batches != 1 || batched != 10 || sum != 55)
+    {
+        throw std::runtime_error("Batched events were not handed over once and contiguously.");
+    }
+
+    if (!local.unsubscribe<AEvent>(second) || local.unsubscribe<AEvent>(second))
+    {
+        throw std::runtime_error("Unsubscribing did not find the subscriber exactly once.");
+    }
+
+    local.close<AEvent>();
+    local.call(AEvent{100});
+    local.open<AEvent>();
+    local.call(AEvent{1});
+    local.dispatch_events<AEvent>();
+
+    if (immediate != 11 || other != 10 || batched != 11 || sum != 56)
+    {
+        throw std::runtime_error("Closed or unsubscribed channel still received events.");
+    }
+
+    // Built-in events queue up for batch subscribers, empty events are coalesced.
+    size_t created = 0, updates = 0;
+    local.subscribe<EntityCreated>([&created](std::span<const EntityCreated> events) { created += events.size(); });
+    local.subscribe<DataUpdated<Health>>([&updates](std::span<const DataUpdated<Health>> events) { updates += events.size(); });
+
+    for (int i = 0; i < 100; i++) local.create(A1(Health{i}));
+    local.dispatch_events();
+
+    if (created != 100 || updates != 1)
+    {
+        throw std::runtime_error("Built-in events were not batched.");
+    }
+}
+
+void test_event_policy()
+{
+    using Quiet = Registry<Archetypes, Events, Singletons, Data<>, ObserveNone>;
+    using Creations = Registry<Archetypes, Events, Singletons, Data<>, Data<EntityCreated>>;
+
+    static_assert(sizeof(Quiet) < sizeof(Registry<Archetypes, Events, Singletons>), "Unobserved built-in events kept their listeners.");
+
+    Quiet quiet;
+    size_t custom = 0;
+    quiet.subscribe<AEvent>([&custom](AEvent) { custom++; });
+    quiet.call(EntityCreated{0});
+    quiet.call(AEvent{1});
+
+    EntityId id = quiet.create(A2(Health{1}, Position{0, 0}));
+    quiet.queue(id, KILL);
+    quiet.update();
+
+    if (custom != 1 || quiet.pool_count<A2>() != 0)
+    {
+        throw std::runtime_error("Event policy dropped user events or broke entity updates.");
+    }
+
+    Creations creations;
+    size_t created = 0;
+    creations.subscribe<EntityCreated>([&created](EntityCreated) { created++; });
+
+    for (int i = 0; i < 10; i++) creations.create(A1(Health{i}));
+    creations.populate(A1(Health{0}), 5);
+
+    if (created != 10)
+    {
+        throw std::runtime_error("Observed built-in event was not fired.");
+    }
+}
+
+void test_find_dispatch()
+{
+    Registry<Archetypes, Events, Singletons> local;
+
+    EntityId a1 = local.create(A1(Health{1}));
+    EntityId a2 = local.create(A2(Health{2}, Position{3, 4}));
+    EntityId a3 = local.create(A3(Health{5}, Position{6, 7}, Name{"Found"}));
+
+    if (local.find<Position>(a1) || local.find<Name>(a2) || local.find<S1>(a3))
+    {
+        throw std::runtime_error("Find matched an archetype lacking the components.");
+    }
+
+    auto [position, health] = local.find<Position, const Health>(a2).value();
+    auto [name] = local.find<Name>(a3).value();
+
+    if (position.y != 4 || health.value != 2 || name.value != "Found")
+    {
+        throw std::runtime_error("Find returned the wrong components.");
+    }
+
+    local.execute(a3, SNOOZE);
+
+    if (!local.find<Name>(a3) || std::get<0>(*local.find<Name>(a3)).value != "Found")
+    {
+        throw std::runtime_error("Find missed a sleeping entity.");
+    }
+
+    local.execute(a1, KILL);
+
+    if (local.find<Health>(a1))
+    {
+        throw std::runtime_error("Find returned a dead entity.");
+    }
+}
+
+void test_sort()
+{
+    Registry<Archetypes, Events, Singletons> local;
+
+    std::vector<EntityId> ids;
+    for (int i = 0; i < 1000; i++) ids.push_back(local.create(A2(Health{(i * 7919) % 1000 - 500}, Position{float(i), 0})));
+
+    Tick since = local.next_tick();
+    std::get<0>(local.get<A2, Health>(ids[10])).value = 10000;
+
+    auto check = [&local, &ids](auto key, const char* error)
+    {
+        // Every entity keeps its own components.
+        for (size_t i = 0; i < ids.size(); i++)
+        {
+            auto [position] = local.get<A2, const Position>(ids[i]);
+
+            if (static_cast<size_t>(position.x) != i)
+            {
+                throw std::runtime_error(error);
+            }
+        }
+
+        auto iter = local.query<const Health>();
+        bool first = true;
+        auto last = key(Health{0});
+
+        for (auto [id, data] : iter)
+        {
+            auto current = key(std::get<0>(data));
+
+            if (!first && current < last) throw std::runtime_error(error);
+
+            first = false;
+            last = current;
+        }
+    };
+
+    // Radix sort by an integral key, including negative values.
+    local.sort<A2, Health>([](const Health& h) { return h.value; });
+    check([](const Health& h) { return h.value; }, "Radix sort did not order the pool or lost entities.");
+
+    // Comparison sort.
+    local.sort<A2, Health>([](const Health& a, const Health& b) { return a.value > b.value; });
+    check([](const Health& h) { return -h.value; }, "Comparison sort did not order the pool or lost entities.");
+
+    // Insertion sort of a nearly sorted pool.
+    std::get<0>(local.get<A2, Health>(ids[500])).value = -100000;
+    local.sort<A2, Health>([](const Health& a, const Health& b) { return a.value > b.value; }, false, INSERTION_SORT);
+    check([](const Health& h) { return -h.value; }, "Insertion sort did not order the pool or lost entities.");
+
+    // Change ticks travel with their entities.
+    size_t changed = 0;
+    local.query_changed<Health, Health>(since).for_each([&changed](Extraction<Health> e) 
+    { 
+        changed++;
+        if (std::get<0>(e.second).value != 10000 && std::get<0>(e.second).value != -100000) throw std::runtime_error("Sort scrambled change ticks.");
+    });
+
+    if (changed != 2)
+    {
+        throw std::runtime_error("Sort lost change ticks.");
+    }
+}
+
+void test_trim_policy()
+{
+    Registry<Archetypes, Events, Singletons> local;
+
+    auto spike = [&local](size_t count)
+    {
+        std::vector<EntityId> ids = local.populate(A2(Health{1}, Position{0, 0}), count);
+        for (size_t i = 0; i < count - 10; i++) local.queue(ids[i], KILL);
+        local.update();
+    };
+
+    spike(100000);
+
+    if (local.capacity<A2>() < 100000)
+    {
+        throw std::runtime_error("Pool shrank without a trim policy.");
+    }
+
+    // Spread over frames: one pool per update, A2's living pool is the third.
+    local.trim_policy({.shrink_below = 0.25, .min_capacity = 64, .pools_per_update = 1});
+    local.update();
+    local.update();
+
+    if (local.capacity<A2>() < 100000)
+    {
+        throw std::runtime_error("Trim policy checked more pools than allowed per update.");
+    }
+
+    local.update();
+
+    if (local.capacity<A2>() > 64 || local.pool_count<A2>() != 10)
+    {
+        throw std::runtime_error("Trim policy did not shrink a sparse pool.");
+    }
+
+    // Memory budget, shrinks regardless of the fraction.
+    local.trim_policy({.memory_budget = 4096});
+    spike(1000);
+
+    if (local.memory() > 4096 || local.pool_count<A2>() != 20)
+    {
+        throw std::runtime_error("Trim policy did not hold the memory budget.");
+    }
+
+    for (auto [id, data] : local.query<Health>())
+    {
+        if (std::get<0>(data).value != 1) throw std::runtime_error("Shrinking corrupted components.");
+    }
+}
+
+struct Buffer 
+{ 
+    std::vector<int> data; 
+
+    size_t heap_size() const { return data.capacity() * sizeof(int); }
+};
+
+using Buffered = Data<Buffer, Health>;
+
+void test_memory_report()
+{
+    static_assert(HeapSized<Buffer> && !HeapSized<Health>, "Incorrect HeapSized detection.");
+
+    Registry<Data<A1, Buffered>, Events, Singletons> local;
+
+    local.subscribe<AEvent>([](std::span<const AEvent>) {});
+    local.call(AEvent{1});
+
+    std::vector<EntityId> ids = local.populate(Buffered(Buffer{std::vector<int>(100)}, Health{1}), 50);
+    local.populate(A1(Health{1}), 1000);
+
+    for (size_t i = 0; i < 10; i++) local.queue(ids[i], KILL);
+    local.update();
+
+    MemoryReport report = local.memory_report();
+    const PoolReport& buffered = report.archetypes[1].living;
+
+    if (buffered.count != 40 || buffered.dead != 10 || buffered.columns.size() != 2 || buffered.capacity < 50)
+    {
+        throw std::runtime_error("Incorrect pool counts in memory report.");
+    }
+
+    if (buffered.columns[0].heap_bytes != 40 * 100 * sizeof(int) || buffered.columns[1].heap_bytes != 0 || report.heap_bytes != buffered.heap_bytes)
+    {
+        throw std::runtime_error("Incorrect heap bytes in memory report.");
+    }
+
+    if (buffered.columns[1].bytes != buffered.columns[1].capacity * sizeof(Health) || report.pool_bytes != local.memory())
+    {
+        throw std::runtime_error("Incorrect column bytes in memory report.");
+    }
+
+    if (report.slots != 1050 || report.reusable_slots != 10 || report.metadata_bytes < 1050 * 8 || report.event_bytes < sizeof(AEvent))
+    {
+        throw std::runtime_error("Incorrect metadata in memory report.");
+    }
+
+    if (report.total() == 0 || peak_rss() < report.total())
+    {
+        throw std::runtime_error("Peak RSS is below the reported memory.");
+    }
+
+    // Reusing a report keeps its memory.
+    const ColumnReport* columns = report.archetypes[1].living.columns.data();
+    local.memory_report(report);
+
+    if (report.archetypes[1].living.columns.data() != columns)
+    {
+        throw std::runtime_error("Refilling a memory report reallocated it.");
+    }
+}
+
+void test_scheduler()
+{
+    using Local = Registry<Archetypes, Events, Singletons>;
+
+    Local local;
+    local.set_workers(4);
+    local.populate(A2(Health{0}, Position{0, 0}), 1000);
+    local.populate(A1(Health{0}), 1000);
+
+    std::atomic<long long> observed = 0;
+    std::atomic<size_t> spawned = 0;
+
+    Scheduler<Local> scheduler(local);
+
+    scheduler
+        .add<Health>("regen", [](Query<Health>& q)
+        {
+            q.for_each([](Extraction<Health> e) { std::get<0>(e.second).value++; });
+        })
+        .add<Position>("integrate", [](Query<Position>& q)
+        {
+            q.for_each([](Extraction<Position> e) { std::get<0>(e.second).x += 1; });
+        })
+        .add<const Health, const Position>("observe", [&observed](Query<const Health, const Position>& q)
+        {
+            long long sum = 0;
+            q.for_each([&sum](Extraction<const Health, const Position> e) 
+            { 
+                auto [health, position] = e.second;
+                sum += health.value + static_cast<long long>(position.x);
+            });
+            observed += sum;
+        })
+        .add<const Name>("names", [](Query<const Name>&) {})
+        .add("spawn", [&local, &spawned]()
+        {
+            local.commands().create(A1(Health{-1}));
+            spawned++;
+        })
+        .sync()
+        .add<Health>("cleanup", [](Query<Health>& q)
+        {
+            q.for_each([](Extraction<Health> e) { if (std::get<0>(e.second).value < 0) std::get<0>(e.second).value = 0; });
+        });
+
+    std::vector<std::vector<std::string>> expected = 
+    {
+        {"regen", "integrate", "names"},
+        {"observe"},
+        {"spawn"},
+        {},
+        {"cleanup"},
+    };
+
+    if (scheduler.batches() != expected)
+    {
+        throw std::runtime_error("Scheduler built incorrect batches.");
+    }
+
+    // A system without components declares no access, so nothing may run beside it.
+    Scheduler<Local> exclusive(local);
+
+    exclusive
+        .add<Health>("regen", [](Query<Health>&) {})
+        .add("tick", []() {})
+        .add<const Name>("names", [](Query<const Name>&) {})
+        .add<Position>("integrate", [](Query<Position>&) {});
+
+    std::vector<std::vector<std::string>> expected_exclusive = {{"regen"}, {"tick"}, {"names", "integrate"}};
+
+    if (exclusive.batches() != expected_exclusive)
+    {
+        throw std::runtime_error("Scheduler ran a system without components beside other systems.");
+    }
+
+    for (int frame = 0; frame < 10; frame++) scheduler.run();
+
+    // After frame f, the 1000 A2 entities have health f + 1 and x f + 1.
+    long long expected_sum = 0;
+    for (int frame = 1; frame <= 10; frame++) expected_sum += 1000LL * frame * 2;
+
+    if (observed != expected_sum || spawned != 10 || local.pool_count<A1>() != 1010)
+    {
+        throw std::runtime_error("Scheduled systems ran incorrectly.");
+    }
+
+    for (auto [id, data] : local.query<const Health>())
+    {
+        if (std::get<0>(data).value < 0) throw std::runtime_error("Sync point did not apply commands before later systems.");
+    }
+}
+
+void test_trace()
+{
+#if defined(NECS_TRACE)
+    Registry<Archetypes, Events, Singletons> local;
+    local.populate(A1(Health{1}), 100);
+
+    {
+        NECS_TRACE_SCOPE("test \"scope\"");
+        local.query<Health>().for_each([](Extraction<Health>) {});
+    }
+
+    std::ostringstream out;
+    Tracer::instance().write(out);
+    std::string trace = out.str();
+
+    for (const char* name : {"\"name\":\"Query::for_each\"", "\"name\":\"Registry::populate\"", "\"name\":\"test \\\"scope\\\"\"", "\"ph\":\"X\""})
+    {
+        if (trace.find(name) == std::string::npos) throw std::runtime_error("Trace is missing a span.");
+    }
+
+    if (trace.rfind("{\"traceEvents\":[", 0) != 0 || !save_trace("necs_trace.json"))
+    {
+        throw std::runtime_error("Trace was not written.");
+    }
+
+    std::remove("necs_trace.json");
+    Tracer::instance().clear();
+#else
+    NECS_TRACE_SCOPE("compiled out");
+
+    if (save_trace("necs_trace.json"))
+    {
+        throw std::runtime_error("Trace was saved with tracing compiled out.");
+    }
+#endif
+}
+
+// Name holds a std::string, so it is saved through the string serializer.
+template <>
+struct NECS::Serializer<Name>
+{
+    static void write(std::ostream& out, const Name& name) { write_value(out, name.value); }
+    static void read(std::istream& in, Name& name) { read_value(in, name.value); }
+};
+
+void test_snapshot()
+{
+    using Local = Registry<Data<A1, A2, A3>, Events, Singletons>;
+
+    Local source;
+    source.populate(A1(Health{1}), 100);
+    std::vector<EntityId> second = source.populate(A2(Health{2}, Position{1, 2}), 100);
+    EntityId third = source.create(A3(Health{3}, Position{3, 4}, Name{"a long name that does not fit in place"}));
+    source.create(A3(Health{4}, Position{5, 6}, Name{"b"}));
+
+    for (size_t i = 0; i < 10; i++) source.queue(second[i], KILL);
+    for (size_t i = 10; i < 20; i++) source.queue(second[i], SNOOZE);
+    source.update();
+
+    // Left pending in the snapshot.
+    source.queue(second[20], KILL);
+    source.queue(second[21], SNOOZE);
+
+    std::stringstream snapshot;
+    source.save(snapshot);
+
+    Local loaded;
+    loaded.populate(A1(Health{9}), 5);
+    loaded.load(snapshot);
+
+    if (loaded.pool_count<A1>() != 100 || loaded.pool_count<A2>() != 80 || loaded.pool_count<A2>(true) != 10 || loaded.pool_count<A3>() != 2)
+    {
+        throw std::runtime_error("Loaded pools have the wrong counts.");
+    }
+
+    auto [name] = loaded.get<A3, Name>(third);
+    auto [pos] = loaded.get<A2, Position>(second[15]);
+
+    if (name.value != "a long name that does not fit in place" || pos.x != 1 || pos.y != 2)
+    {
+        throw std::runtime_error("Loaded components do not match the saved ones.");
+    }
+
+    if (loaded.is_alive(second[0]) || !loaded.is_state(second[20], KILLED) || !loaded.is_state(second[15], SLEEPING))
+    {
+        throw std::runtime_error("Loaded entity states do not match the saved ones.");
+    }
+
+    // The pending kill survives and dead slots are reused in the same order.
+    source.update();
+    loaded.update();
+
+    if (loaded.pool_count<A2>() != 78 || loaded.pool_count<A2>(true) != 11 || source.create(A1(Health{0})) != loaded.create(A1(Health{0})))
+    {
+        throw std::runtime_error("Loaded metadata does not match the saved one.");
+    }
+
+    // Serialized right away and written to the file in the background, then loaded from the file.
+    std::future<bool> saved = loaded.save_async("necs_snapshot.bin");
+    loaded.populate(A1(Health{0}), 1000);
+
+    Local from_file;
+
+    if (!saved.get())
+    {
+        throw std::runtime_error("Snapshot was not saved.");
+    }
+
+    from_file.load("necs_snapshot.bin");
+    std::remove("necs_snapshot.bin");
+
+    if (from_file.save("missing_directory/necs_snapshot.bin") || from_file.save_async("missing_directory/necs_snapshot.bin").get())
+    {
+        throw std::runtime_error("Saving to a file that cannot be written succeeded.");
+    }
+
+    if (from_file.pool_count<A1>() != 101 || from_file.pool_count<A2>() != 78)
+    {
+        throw std::runtime_error("Snapshot saved in the background does not match the registry.");
+    }
+
+    // Snapshots of other archetypes are rejected.
+    std::stringstream other;
+    Registry<Data<A1>, Events, Singletons>().save(other);
+
+    try 
+    {
+        loaded.load(other);
+        throw std::logic_error("Loaded a snapshot of other archetypes.");
+    }
+    catch (const std::runtime_error&) {}
+
+    // Corrupt and truncated snapshots either load or throw, they never index out of bounds.
+    std::string bytes = snapshot.str();
+    size_t rejected = 0;
+
+    for (size_t i = 0; i < bytes.size(); i++)
+    {
+        for (char flip : {char(0x01), char(0x80), char(0xFF)})
+        {
+            std::stringstream corrupt(std::string(bytes).replace(i, 1, 1, static_cast<char>(bytes[i] ^ flip)));
+
+            try { loaded.load(corrupt); }
+            catch (const std::runtime_error&) { rejected++; }
+        }
+    }
+
+    for (size_t size = 0; size < bytes.size(); size += 7)
+    {
+        std::stringstream truncated(bytes.substr(0, size));
+
+        try 
+        {
+            loaded.load(truncated);
+            throw std::logic_error("Loaded a truncated snapshot.");
+        }
+        catch (const std::runtime_error&) {}
+    }
+
+    if (rejected == 0) throw std::runtime_error("No corrupt snapshot was rejected.");
+
+    // A snapshot that lists a dead slot twice would hand it out to two entities.
+    auto encode = [](uint64_t value) { return std::string(reinterpret_cast<const char*>(&value), sizeof(value)); };
+    size_t reuse = bytes.find(encode(10) + encode(id_slot(second[0])));
+
+    if (reuse == std::string::npos) throw std::runtime_error("Snapshot does not list the dead slots.");
+
+    try 
+    {
+        std::stringstream duplicated(std::string(bytes).replace(reuse + 16, 8, encode(id_slot(second[0]))));
+        loaded.load(duplicated);
+        throw std::logic_error("Loaded a snapshot that reuses a slot twice.");
+    }
+    catch (const std::runtime_error&) {}
+
+    // Queued ids must be exactly the pending entities, update would move them again otherwise.
+    auto encode_id = [](EntityId id) { return std::string(reinterpret_cast<const char*>(&id), sizeof(id)); };
+    size_t queue = bytes.find(encode(2) + encode_id(second[20]) + encode_id(second[21]));
+
+    if (queue == std::string::npos) throw std::runtime_error("Snapshot does not list the queued entities.");
+
+    for (EntityId id : {second[22], second[20]})
+    {
+        try 
+        {
+            std::stringstream crafted(std::string(bytes).replace(queue + 8 + sizeof(EntityId), sizeof(EntityId), encode_id(id)));
+            Local target;
+            target.load(crafted);
+            target.update();
+            throw std::logic_error("Loaded a snapshot that queues a live or duplicated entity.");
+        }
+        catch (const std::runtime_error&) {}
+    }
+
+    // Commands recorded before a load are dropped.
+    snapshot.clear();
+    snapshot.seekg(0);
+    loaded.commands().create(A1(Health{0}));
+    loaded.queue(third, KILL);
+    loaded.load(snapshot);
+    loaded.flush();
+
+    if (loaded.pool_count<A1>() != 100 || !loaded.is_alive(third))
+    {
+        throw std::runtime_error("Changes recorded before a load reached the loaded registry.");
+    }
 }
 
 int main()
@@ -126,6 +1649,29 @@ int main()
     test_populate();
     test_query();
     test_has_component();
+    test_generations();
+    test_par_for_each();
+    test_each_chunk();
+    test_populate_batch();
+    test_move_and_emplace();
+    test_batched_update();
+    test_command_buffers();
+    test_command_order();
+    test_command_churn();
+    test_memory_resources();
+    test_cached_queries();
+    test_chunked_storage();
+    test_iteration_changes();
+    test_change_ticks();
+    test_event_channels();
+    test_event_policy();
+    test_find_dispatch();
+    test_sort();
+    test_trim_policy();
+    test_memory_report();
+    test_scheduler();
+    test_trace();
+    test_snapshot();
     std::cout << "=== Run succeeded ===\n";
 
     return 0;
@@ -3,17 +3,49 @@
 #include <algorithm>
 #include <any>
 #include <array>
+#include <bit>
+#include <atomic>
+#include <compare>
+#include <condition_variable>
+#include <cstring>
+#include <cstdint>
+#include <deque>
 #include <exception>
+#include <fstream>
 #include <functional>
+#include <future>
 #include <iostream>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <numeric>
 #include <optional>
+#include <ranges>
+#include <span>
+#include <sstream>
+#include <stdexcept>
 #include <string>
+#include <thread>
 #include <tuple>
-#include <typeindex>
 #include <type_traits>
 #include <typeinfo>
+#include <utility>
 #include <vector>
 
+#if defined(__linux__)
+#include <sys/mman.h>
+#endif
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#endif
+
+#if defined(NECS_TRACE)
+#include <chrono>
+#endif
+
 namespace NECS
 {
     // ----------------------------------------------------------------------------
@@ -96,6 +128,16 @@ namespace NECS
                 has_type<T, std::tuple<Tail...>>
             > {};
 
+        template<typename T, typename Tuple>
+        struct index_of;
+
+        template<typename T, typename... Tail>
+        struct index_of<T, std::tuple<T, Tail...>> : std::integral_constant<size_t, 0> {};
+
+        template<typename T, typename Head, typename... Tail>
+        struct index_of<T, std::tuple<Head, Tail...>> 
+            : std::integral_constant<size_t, 1 + index_of<T, std::tuple<Tail...>>::value> {};
+
         template<typename T, typename... Ts>
         struct has_all_types : std::conjunction<has_type<Ts, T>...> {};
 
@@ -138,50 +180,6 @@ namespace NECS
             using type = std::index_sequence<>;
         };
 
-        template <typename Tuple, typename Seq, typename With, typename Without>
-        struct match_index;
-
-        template <
-            typename Tuple, 
-            std::size_t I, 
-            std::size_t... Is, 
-            typename... WithTs, 
-            typename... WithoutTs>
-        struct match_index
-        <
-            Tuple, std::index_sequence<I, Is...>, 
-            std::tuple<WithTs...>, 
-            std::tuple<WithoutTs...>
-        > 
-        {
-            using Tail = typename match_index
-            <
-                Tuple, 
-                std::index_sequence<Is...>, 
-                std::tuple<WithTs...>, 
-                std::tuple<WithoutTs...>
-            >::type;
-
-            using CurrentTuple = std::tuple_element_t<I, Tuple>;
-
-            static constexpr bool match =
-                has_all_types<CurrentTuple, WithTs...>::value &&
-                !has_any_type<CurrentTuple, WithoutTs...>::value;
-
-            using type = std::conditional_t
-            <
-                match,
-                typename Filter::concat_index<I, Tail>::type,
-                Tail
-            >;
-        };
-
-        template <typename Tuple, typename With, typename Without>
-        struct match_index<Tuple, std::index_sequence<>, With, Without> {
-            using type = std::index_sequence<>;
-        };
-
-
         template <typename Tuple, typename... Ts>
         constexpr auto Indices() 
         {
@@ -193,9 +191,6 @@ namespace NECS
             }
             (typename filter_index<Tuple, Indices, Ts...>::type{});
         }
-
-        template <typename Tuple, typename With = std::tuple<>, typename Without = std::tuple<>>
-        using Match = match_index<Tuple, std::make_index_sequence<std::tuple_size_v<Tuple>>, With, Without>::type;
     };
     
     // ----------------------------------------------------------------------------
@@ -229,1606 +224,6596 @@ namespace NECS
     using View = std::optional<Data<Cs&...>>;
 
     // ----------------------------------------------------------------------------
-    // Entity
+    // Signature
     // ---------------------------------------------------------------------------- 
 
     /**
-     * A unique index associated with an entity. It will remain contant across 
-     * the entity's lifetime. Dead entities have their ids reused if they aren't
-     * id_locked (made life-time unique).
-     */
-    using EntityId = size_t;
-
-    /**
-     * The action to perform on an entity, either right away or delayed.
+     * Constexpr set of component bits, see Signatures. 
+     * 
+     * @tparam N The number of bits.
      */
-    enum EntityTask
+    template <size_t N>
+    class Signature
     {
-        KILL, // The entity should be marked as KILLED if LIVE.
-        SNOOZE, // The entity should be marked as SNOOZED if LIVE.
-        WAKE // The entity should be marked as AWAKE if SLEEPING.
+        std::array<uint64_t, (N + 63) / 64> m_words = {};
+
+        public:
+            constexpr void set(size_t bit)
+            {
+                m_words[bit / 64] |= uint64_t(1) << (bit % 64);
+            }
+
+            constexpr bool test(size_t bit) const
+            {
+                return (m_words[bit / 64] >> (bit % 64)) & 1;
+            }
+
+            // Whether every bit of other is set.
+            constexpr bool contains(const Signature& other) const
+            {
+                for (size_t i = 0; i < m_words.size(); i++)
+                {
+                    if ((m_words[i] & other.m_words[i]) != other.m_words[i]) return false;
+                }
+
+                return true;
+            }
+
+            // Whether any bit of other is set.
+            constexpr bool intersects(const Signature& other) const
+            {
+                for (size_t i = 0; i < m_words.size(); i++)
+                {
+                    if (m_words[i] & other.m_words[i]) return true;
+                }
+
+                return false;
+            }
+
+            // Whether every bit of with and no bit of without is set.
+            constexpr bool matches(const Signature& with, const Signature& without = {}) const
+            {
+                return contains(with) && !intersects(without);
+            }
+
+            constexpr size_t count() const
+            {
+                size_t total = 0;
+                for (uint64_t word : m_words) total += std::popcount(word);
+                return total;
+            }
+
+            constexpr Signature operator|(const Signature& other) const
+            {
+                Signature result = *this;
+                for (size_t i = 0; i < m_words.size(); i++) result.m_words[i] |= other.m_words[i];
+                return result;
+            }
+
+            constexpr Signature operator&(const Signature& other) const
+            {
+                Signature result = *this;
+                for (size_t i = 0; i < m_words.size(); i++) result.m_words[i] &= other.m_words[i];
+                return result;
+            }
+
+            constexpr bool operator==(const Signature& other) const = default;
     };
 
     /**
-     * The current state of the entity. It carries location info (pool) and tracks
-     * what tasks are allowed for this entity.
-     *
-     * KILLED, SNOOZED and AWAKE are pending states that signal that an entity is 
-     * about to change locations on next update (either pool or index). These states 
-     * cannot be changed until they are processed. LIVE and SLEEPING are stable 
-     * states that allow for entities to be updated via an EntityTask.
+     * Compile-time component signatures of a set of archetypes.
      * 
-     * LIVE, SNOOZED and KILLED entities are located in the living pool of their 
-     * storage. SLEEPING and AWAKE entities are located in the sleeping pool.
+     * Every component used by the archetypes gets a bit, const qualifiers are 
+     * ignored. Components outside of the archetypes all share one extra bit 
+     * that no archetype has, so requiring them never matches and excluding 
+     * them never filters anything out.
      * 
-     * DEAD entities are removed from the system and are not updated. Their 
-     * information can still be accessed if the storage hasn't overwritten it or 
-     * that memory has not been freed, but this is undefined behavior.
+     * @tparam As The archetypes, as a Data<As...>.
      */
-    enum EntityState
+    template <typename As>
+    struct Signatures;
+
+    template <typename... As>
+    struct Signatures<Data<As...>>
     {
-        LIVE, // The entity is ready to be used and can be killed or snoozed.
-        KILLED, // The entity has been marked for DEAD.
-        DEAD, // The entity cannot be used or read anymore.
-        SNOOZED, // The entity has been marked for SLEEP.
-        SLEEPING, // The entity is put to sleep, it can still be accessed, iterated and changed, but not killed.
-        AWAKE, // The entity is marked for LIVE.
-    };
+        using Components = typename Filter::merge_types<As...>::type;
+        using Type = Signature<std::tuple_size_v<Components> + 1>;
 
-    // The total number of EntityStates.
-    const size_t STATE_COUNT = 6;
+        // The bit of a component.
+        template <typename C>
+        static constexpr size_t bit = []
+        {
+            if constexpr (Filter::has_type<std::remove_const_t<C>, Components>::value)
+            {
+                return Filter::index_of<std::remove_const_t<C>, Components>::value;
+            }
+            else 
+            {
+                return std::tuple_size_v<Components>;
+            }
+        }();
 
-    // A struct containing some location info on an entity. 
-    struct EntityInfo
-    {
-        std::type_index type = std::type_index(typeid(int));
-        size_t index = -1;
-        EntityState state = LIVE;
-        bool id_locked = false;
-    };
+        // The signature of a set of components.
+        template <typename... Cs>
+        static constexpr Type of = []
+        {
+            Type signature;
+            (signature.set(bit<Cs>),...);
+            return signature;
+        }();
+
+        // The signature of a Data<Cs...>.
+        template <typename D>
+        static constexpr Type of_data = []<typename... Cs>(std::type_identity<Data<Cs...>>)
+        {
+            return of<Cs...>;
+        }
+        (std::type_identity<D>{});
 
-     // A struct containing an info struct and utility methods. 
-    struct EntityData
-    {
-        EntityInfo info; // Location data on the entity inside of its storage.
-        std::function<void()> update = {};
-        std::function<bool(std::type_index)> has_component = {};
+        // The signature of every archetype, by archetype id.
+        static constexpr std::array<Type, sizeof...(As)> archetypes = {of_data<As>...};
+
+        // The archetype ids matching a with/without filter, and their count.
+        template <typename Ws, typename Wos>
+        static constexpr auto matched = []
+        {
+            std::pair<std::array<size_t, sizeof...(As)>, size_t> result = {};
+
+            for (size_t a = 0; a < sizeof...(As); a++)
+            {
+                if (archetypes[a].matches(of_data<Ws>, of_data<Wos>)) result.first[result.second++] = a;
+            }
+
+            return result;
+        }();
+
+        // The archetype ids matching a with/without filter, as an index_sequence.
+        template <typename Ws, typename Wos>
+        using Match = decltype([]<size_t... Is>(std::index_sequence<Is...>)
+        {
+            return std::index_sequence<matched<Ws, Wos>.first[Is]...>{};
+        }
+        (std::make_index_sequence<matched<Ws, Wos>.second>{}));
     };
 
+    // ----------------------------------------------------------------------------
+    // Trace
+    // ---------------------------------------------------------------------------- 
+
     /**
-     * Entity metadata manager class. 
-     * Contains type-erased data and manages EntityId allocations.
+     * Scoped spans of internal operations and user code, compiled out unless 
+     * NECS_TRACE is defined before including the header.
      * 
-     * Each EntityId is a fixed index in its data array.
+     * Every thread records into its own ring buffer of NECS_TRACE_CAPACITY spans 
+     * (65536 by default), overwriting its oldest spans when full, so recording 
+     * takes no lock. save_trace writes every buffer as Chrome trace JSON, which 
+     * opens in chrome://tracing and Perfetto.
      * 
-     * It is always called on internally and is not exposed. 
+     * NECS_TRACE_SCOPE("name") traces the rest of the enclosing scope. Names 
+     * must outlive the trace, use Tracer::intern for names built at runtime.
      */
-    struct Entities 
-    {
-        // ---- Entity data ---- //
+#if defined(NECS_TRACE)
 
-        std::vector<EntityData> data; // Vector of all the entities currently in the system, at their EntityId index.
+#ifndef NECS_TRACE_CAPACITY
+#define NECS_TRACE_CAPACITY 65536
+#endif
 
-        // ---- Counter ---- //
+    // A finished span, with times in nanoseconds since the tracer started.
+    struct TraceSpan
+    {
+        const char* name;
+        uint64_t begin;
+        uint64_t end;
+    };
 
-        std::array<size_t, STATE_COUNT> counter; // Holds the amount of entites available by state.
+    // Ring buffer of the spans of one thread.
+    class TraceBuffer
+    {
+        std::vector<TraceSpan> m_spans = std::vector<TraceSpan>(NECS_TRACE_CAPACITY);
+        std::atomic<size_t> m_written = 0;
+        size_t m_thread;
 
-        // ---- State management ---- //
+        public: 
+            explicit TraceBuffer(size_t thread) : m_thread(thread) {}
 
-        size_t to_update_end = 0; 
-        std::vector<EntityId> to_update; // Ids to update by the registry.
-        std::vector<EntityId> to_reuse; // Erased ids that can be reused.
+            size_t thread() const { return m_thread; }
 
-        /**
-         * Ties an id and metadata to a new entity. An id will be reused if available.
-         * 
-         * @param info The new entity's location info. 
-         * 
-         * @returns The new id and metadata object. 
-         */
-        auto create(EntityInfo info) -> std::pair<EntityId, EntityData&>
-        {
-            counter[info.state]++;
+            void record(const TraceSpan& span)
+            {
+                size_t written = m_written.load(std::memory_order_relaxed);
+                m_spans[written % m_spans.size()] = span;
+                m_written.store(written + 1, std::memory_order_release);
+            }
 
-            if (to_reuse.size() > 0)
-            {   
-                counter[DEAD]--;
-                EntityId id = to_reuse.back();
-                data[id] = {info};
-                to_reuse.pop_back();
-                return {id, data[id]};
+            // Calls f with every span still in the buffer, oldest first.
+            template <typename F>
+            void each(F&& f) const
+            {
+                size_t written = m_written.load(std::memory_order_acquire);
+                size_t first = written > m_spans.size() ? written - m_spans.size() : 0;
+
+                for (size_t i = first; i < written; i++) f(m_spans[i % m_spans.size()]);
             }
-            else 
+
+            void clear()
             {
-                EntityId id = data.size();
-                data.push_back({info});
-                return {id, data[id]};
+                m_written.store(0, std::memory_order_release);
             }
-        }
+    };
 
+    /**
+     * Owns the trace buffers of every thread. Buffers outlive their threads, 
+     * so spans of finished threads are still saved.
+     */
+    class Tracer
+    {
+        std::mutex m_mutex;
+        std::vector<std::unique_ptr<TraceBuffer>> m_buffers;
+        std::deque<std::string> m_names;
+        std::chrono::steady_clock::time_point m_epoch = std::chrono::steady_clock::now();
 
-        // Updates all queued entities.
-        void update()
+        static void escape(std::ostream& out, const char* name)
         {
-            for (size_t i = 0; i < to_update_end; i++)
+            for (; *name; name++)
             {
-                EntityId id = to_update[i];
-
-                data[id].update();
+                if (*name == '"' || *name == '\\') out << '\\';
+                if (static_cast<unsigned char>(*name) >= 0x20) out << *name;
             }
-
-            to_update_end = 0;
         }
 
-        /**
-         * Queues an entity to be updated. 
-         * 
-         * @tparam Callback the type of the callback to be invoked.
-         * 
-         * @param id The entity to queue.
-         * @param task The type of task to queue for. 
-         * @param callback The event callback to call on success.
-         */
-        template <typename Callback>
-        void queue(EntityId id, EntityTask task, Callback&& callback)
+        // Writes nanoseconds as microseconds, which trace viewers expect, without losing precision.
+        static void micros(std::ostream& out, uint64_t ns)
         {
-            auto& entity = data[id];
+            char fraction[4] = {char('0' + ns % 1000 / 100), char('0' + ns % 100 / 10), char('0' + ns % 10), '\0'};
+            out << ns / 1000 << '.' << fraction;
+        }
 
-            EntityState req_state = 
-                task == KILL || task == SNOOZE
-                ? LIVE
-                : SLEEPING;
-                
-            EntityState res_state = 
-                task == KILL 
-                ? KILLED 
-                : task == SNOOZE
-                ? SNOOZED 
-                : AWAKE;
+        public: 
+            static auto instance() -> Tracer&
+            {
+                static Tracer tracer;
+                return tracer;
+            }
 
-            if (entity.info.state == req_state)
+            // Nanoseconds since the tracer started.
+            uint64_t now() const
             {
-                if (to_update_end == to_update.size())
+                return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - m_epoch).count();
+            }
+
+            // The buffer of the calling thread, created on first use.
+            auto local() -> TraceBuffer&
+            {
+                static thread_local TraceBuffer* t_buffer = nullptr;
+
+                if (!t_buffer)
                 {
-                    to_update.push_back(id);
+                    std::lock_guard lock(m_mutex);
+                    t_buffer = m_buffers.emplace_back(std::make_unique<TraceBuffer>(m_buffers.size())).get();
                 }
-                else 
+
+                return *t_buffer;
+            }
+
+            // Copies a name into storage that lives as long as the tracer.
+            auto intern(std::string name) -> const char*
+            {
+                std::lock_guard lock(m_mutex);
+                return m_names.emplace_back(std::move(name)).c_str();
+            }
+
+            /**
+             * Writes every recorded span as Chrome trace JSON. 
+             * Threads should not be recording while the trace is written.
+             */
+            void write(std::ostream& out)
+            {
+                std::lock_guard lock(m_mutex);
+
+                out << "{\"traceEvents\":[";
+
+                bool first = true;
+
+                for (const auto& buffer : m_buffers)
                 {
-                    to_update[to_update_end] = id;
-                }   
+                    buffer->each([&out, &first, &buffer](const TraceSpan& span)
+                    {
+                        out << (first ? "\n" : ",\n") << "{\"name\":\"";
+                        escape(out, span.name);
+                        out 
+                        << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->thread() 
+                        << ",\"ts\":";
+                        micros(out, span.begin);
+                        out << ",\"dur\":";
+                        micros(out, span.end - span.begin);
+                        out << "}";
+                        first = false;
+                    });
+                }
 
-                to_update_end++;
-                entity.info.state = res_state;
-                counter[req_state]--;
-                counter[res_state]++;
+                out << "\n],\"displayTimeUnit\":\"ns\"}\n";
+            }
 
-                callback(req_state, res_state);
+            // Drops every recorded span.
+            void clear()
+            {
+                std::lock_guard lock(m_mutex);
+                for (auto& buffer : m_buffers) buffer->clear();
             }
-        }
-    
-        /**
-         * Executes a state change for an entity instantly. 
-         * 
-         * @param id The entity to change.
-         * @param task The type of task to execute.
-         */
-        void execute(EntityId id, EntityTask task)
-        {
-            auto& entity = data[id];
+    };
 
-            EntityState req_state = 
-                task == KILL || task == SNOOZE
-                ? LIVE
-                : SLEEPING;
-                
-            EntityState res_state = 
-                task == KILL 
-                ? KILLED 
-                : task == SNOOZE
-                ? SNOOZED 
-                : AWAKE;
+    // Records a span from its construction to the end of its scope.
+    class TraceScope
+    {
+        const char* m_name;
+        uint64_t m_begin;
 
-            if (entity.info.state == req_state)
-            { 
-                entity.info.state = res_state;
-                counter[req_state]--;
-                counter[res_state]++;
-                entity.update();
+        public: 
+            explicit TraceScope(const char* name) : m_name(name), m_begin(Tracer::instance().now()) {}
+
+            TraceScope(const TraceScope&) = delete;
+            TraceScope& operator=(const TraceScope&) = delete;
+
+            ~TraceScope()
+            {
+                Tracer& tracer = Tracer::instance();
+                tracer.local().record({m_name, m_begin, tracer.now()});
             }
-        }
     };
 
+#define NECS_TRACE_CONCAT_(a, b) a##b
+#define NECS_TRACE_CONCAT(a, b) NECS_TRACE_CONCAT_(a, b)
+#define NECS_TRACE_SCOPE(name) ::NECS::TraceScope NECS_TRACE_CONCAT(necs_trace_scope_, __LINE__)(name)
+
+#else
+
+#define NECS_TRACE_SCOPE(name) ((void)0)
+
+#endif
+
+    /**
+     * Saves the recorded spans as Chrome trace JSON. 
+     * 
+     * @param path The file to write.
+     * 
+     * @returns False if tracing is compiled out or the file could not be written.
+     */
+    inline bool save_trace([[maybe_unused]] const std::string& path)
+    {
+#if defined(NECS_TRACE)
+        std::ofstream out(path);
+        if (!out) return false;
+
+        Tracer::instance().write(out);
+        return static_cast<bool>(out);
+#else
+        return false;
+#endif
+    }
 
     // ----------------------------------------------------------------------------
-    // Listener & Event
+    // Snapshot
     // ---------------------------------------------------------------------------- 
 
+    // The version of the snapshot format, bumped whenever its layout changes.
+    const uint32_t SNAPSHOT_VERSION = 1;
+
+    // The bytes every snapshot starts with.
+    const char SNAPSHOT_MAGIC[4] = {'N', 'E', 'C', 'S'};
+
     /**
-     * Single-callback event listener class.
-     * Contains functions for subscribing, unsubscribing and calling events.
-     * The listener is always called on internally and is not exposed.
+     * Writes and reads a value that is not trivially copyable to and from a 
+     * snapshot. Specialize it with static write(std::ostream&, const T&) and 
+     * read(std::istream&, T&) members, like the std::string specialization. 
      * 
-     * @tparam E The event to listen to.
+     * Trivially copyable components do not need one, their columns are 
+     * written as raw blocks of memory.
+     * 
+     * @tparam T The type to serialize.
      */
-    template <typename E>
-    struct Listener 
-    {   
-        bool set = false; // is the function set for the first time
-        bool ready = false; // is the current callback subscribed
-        std::function<void(E)> callback = {}; // the callback to call
+    template <typename T>
+    struct Serializer;
+
+    template <typename T>
+    concept Serializable = std::is_trivially_copyable_v<T> || requires(std::ostream& out, std::istream& in, const T& value, T& target)
+    {
+        Serializer<T>::write(out, value);
+        Serializer<T>::read(in, target);
     };
 
-    // Empty, built-in templated event for A and C, fired whenever data moves around in the registry.
+    // Writes the raw memory of count trivially copyable values.
     template <typename T>
-    struct DataUpdated {};
-    // Built-in event fired on entity creation. Contains the new entity's id.
-    struct EntityCreated { EntityId id; };
-    // Built-in event fired on state changes. Contains the id, the previous and new states.
-    struct EntityUpdated { EntityId id; EntityState prev_state; EntityState new_state; }; 
+    void write_bytes(std::ostream& out, const T* values, size_t count)
+    {
+        out.write(reinterpret_cast<const char*>(values), static_cast<std::streamsize>(count * sizeof(T)));
+    }
 
+    // Reads the raw memory of count trivially copyable values.
     template <typename T>
-    auto InitBuiltInListeners()
+    void read_bytes(std::istream& in, T* values, size_t count)
     {
-        return []<typename... As>(std::tuple<As...>) 
+        in.read(reinterpret_cast<char*>(values), static_cast<std::streamsize>(count * sizeof(T)));
+
+        if (!in) throw std::runtime_error("@read_bytes - snapshot ended early.");
+    }
+
+    // Writes one value, as raw memory if it is trivially copyable.
+    template <Serializable T>
+    void write_value(std::ostream& out, const T& value)
+    {
+        if constexpr (std::is_trivially_copyable_v<T>) write_bytes(out, &value, 1);
+        else Serializer<T>::write(out, value);
+    }
+
+    // Reads one value, as raw memory if it is trivially copyable.
+    template <Serializable T>
+    void read_value(std::istream& in, T& value)
+    {
+        if constexpr (std::is_trivially_copyable_v<T>) read_bytes(in, &value, 1);
+        else Serializer<T>::read(in, value);
+    }
+
+    template <typename T>
+    auto read_value(std::istream& in) -> T
+    {
+        T value{};
+        read_value(in, value);
+        return value;
+    }
+
+    /**
+     * Reads a length prefix. Throws if it is over max, or if a seekable stream 
+     * has fewer bytes left than length elements of element_bytes each, so 
+     * that a corrupt length never allocates more than the snapshot can hold.
+     */
+    inline size_t read_length(std::istream& in, size_t element_bytes, size_t max = SIZE_MAX)
+    {
+        uint64_t length = read_value<uint64_t>(in);
+
+        if (length > max) throw std::runtime_error("@read_length - snapshot holds an invalid length.");
+
+        std::istream::pos_type here = in.tellg();
+
+        if (element_bytes > 0 && here != std::istream::pos_type(-1))
         {
-            using UniqueComponents = typename Filter::merge_types<As...>::type;
+            in.seekg(0, std::ios::end);
+            std::istream::pos_type end = in.tellg();
+            in.seekg(here);
 
-            return [] <typename... Cs> (std::tuple<Cs...>)
-            {   
-                return std::tuple
-                <
-                    Listener<EntityCreated>, 
-                    Listener<EntityUpdated>, 
-                    Listener<DataUpdated<As>>..., 
-                    Listener<DataUpdated<Cs>>...
-                >{};
-            } 
-            (UniqueComponents{});
+            if (end != std::istream::pos_type(-1) && length > static_cast<uint64_t>(end - here) / element_bytes)
+            {
+                throw std::runtime_error("@read_length - snapshot is shorter than a length it holds.");
+            }
         }
-        (T{});
+
+        return length;
     }
 
-    template <typename As, typename Es>
-    auto InitListeners()
+    template <typename CharT, typename Traits, typename Allocator>
+    struct Serializer<std::basic_string<CharT, Traits, Allocator>>
     {
-        return [] <typename... Ts>(std::tuple<Ts...>)
+        static void write(std::ostream& out, const std::basic_string<CharT, Traits, Allocator>& value)
         {
-            using BuiltInEvents = std::invoke_result_t<decltype(InitBuiltInListeners<As>)>;
-            using GameEvents = std::tuple<Listener<Ts>...>;
+            write_value<uint64_t>(out, value.size());
+            write_bytes(out, value.data(), value.size());
+        }
 
-            return std::tuple_cat(BuiltInEvents{}, GameEvents{});
+        static void read(std::istream& in, std::basic_string<CharT, Traits, Allocator>& value)
+        {
+            value.resize(read_length(in, sizeof(CharT)));
+            read_bytes(in, value.data(), value.size());
+        }
+    };
+
+    template <Serializable T, typename Allocator>
+    struct Serializer<std::vector<T, Allocator>>
+    {
+        static void write(std::ostream& out, const std::vector<T, Allocator>& value)
+        {
+            write_value<uint64_t>(out, value.size());
+
+            if constexpr (std::is_trivially_copyable_v<T>) write_bytes(out, value.data(), value.size());
+            else for (const T& v : value) write_value(out, v);
         }
-        (Es{});
-    }
-    
-    template <typename As, typename Es>
-    using Listeners = std::invoke_result_t<decltype(InitListeners<As, Es>)>;
+
+        static void read(std::istream& in, std::vector<T, Allocator>& value)
+        {
+            if constexpr (std::is_trivially_copyable_v<T>) 
+            {
+                value.resize(read_length(in, sizeof(T)));
+                read_bytes(in, value.data(), value.size());
+            }
+            else 
+            {
+                // The size of an element is unknown, grow with the elements actually read.
+                size_t count = read_length(in, 0);
+
+                value.clear();
+
+                for (size_t i = 0; i < count; i++) 
+                {
+                    T v{};
+                    read_value(in, v);
+                    value.push_back(std::move(v));
+                }
+            }
+        }
+    };
 
     // ----------------------------------------------------------------------------
-    // Extraction
+    // Entity
     // ---------------------------------------------------------------------------- 
 
     /**
-     * Type returned by iterators and queries.
-     * Pair consisting of an EntityId copy and a tuple of component references.
+     * A generational handle to an entity. It will remain constant across the 
+     * entity's lifetime.
      * 
-     * @tparam Cs... The extracted components.
+     * The low bits hold the entity's slot in the metadata arrays and the high 
+     * bits hold the slot's generation. Slots are reused once their entity dies, 
+     * but the generation is bumped on death, so handles to dead entities are 
+     * recognized as stale with a single compare.
+     * 
+     * Defining NECS_32BIT_IDS before including the header halves the size of 
+     * ids in the metadata and in every pool. The slot bits can be set with 
+     * NECS_SLOT_BITS, they default to 32 for 64-bit ids and 20 for 32-bit ids.
+     * 
+     * Generations wrap around once a slot has died 2^(bits - NECS_SLOT_BITS) 
+     * times, after which a stale handle matches the slot's new entity again. 
+     * The defaults leave 32 generation bits for 64-bit ids and 12 for 32-bit 
+     * ids, so with 32-bit ids a handle kept across 4096 deaths of its slot can 
+     * alias a live entity. Fewer slot bits trade the maximum entity count 
+     * (1M with the 32-bit default) for a longer wrap period.
      */
-    template <typename... Cs>
-    using Extraction = std::pair<EntityId, Data<Cs&...>>;
+#ifdef NECS_32BIT_IDS
+    using EntityId = uint32_t;
+#else
+    using EntityId = uint64_t;
+#endif
+
+#ifdef NECS_SLOT_BITS
+    const size_t SLOT_BITS = NECS_SLOT_BITS;
+#else
+    const size_t SLOT_BITS = sizeof(EntityId) == 4 ? 20 : 32;
+#endif
+
+    static_assert(SLOT_BITS > 0 && SLOT_BITS < sizeof(EntityId) * 8, "NECS_SLOT_BITS must leave room for a generation.");
+
+    // The generation of an entity slot, incremented every time its entity dies.
+    using Generation = uint32_t;
+
+    const EntityId SLOT_MASK = (EntityId(1) << SLOT_BITS) - 1;
+    const Generation GENERATION_MASK = static_cast<Generation>(~EntityId(0) >> SLOT_BITS);
+
+    // Gets the metadata slot of an entity handle.
+    constexpr size_t id_slot(EntityId id)
+    {
+        return id & SLOT_MASK;
+    }
+
+    // Gets the generation of an entity handle.
+    constexpr Generation id_generation(EntityId id)
+    {
+        return static_cast<Generation>(id >> SLOT_BITS);
+    }
+
+    // Combines a metadata slot and its generation into an entity handle.
+    constexpr EntityId make_id(size_t slot, Generation generation)
+    {
+        return (static_cast<EntityId>(generation) << SLOT_BITS) | static_cast<EntityId>(slot);
+    }
 
-    // ----------------------------------------------------------------------------
-    // Iterator
-    // ---------------------------------------------------------------------------- 
-    
     /**
-     * A pool-level iterator.
+     * The position of an archetype in the registry's Archetypes tuple. Used to 
+     * dispatch type-erased operations through per-archetype tables.
+     */
+    using ArchetypeId = uint16_t;
+
+    // The position of an entity inside of its pool.
+    using PoolIndex = uint32_t;
+
+    /**
+     * The action to perform on an entity, either right away or delayed.
+     */
+    enum EntityTask : uint8_t
+    {
+        KILL, // The entity should be marked as KILLED if LIVE.
+        SNOOZE, // The entity should be marked as SNOOZED if LIVE.
+        WAKE // The entity should be marked as AWAKE if SLEEPING.
+    };
+
+    /**
+     * The current state of the entity. It carries location info (pool) and tracks
+     * what tasks are allowed for this entity.
+     *
+     * KILLED, SNOOZED and AWAKE are pending states that signal that an entity is 
+     * about to change locations on next update (either pool or index). These states 
+     * cannot be changed until they are processed. LIVE and SLEEPING are stable 
+     * states that allow for entities to be updated via an EntityTask.
      * 
-     * It contains references to the desired component vectors. 
-     * Since storages & their pools exist for the entire duration of the program, 
-     * it can safely hold references to the storage's data indefinitely.
+     * LIVE, SNOOZED and KILLED entities are located in the living pool of their 
+     * storage. SLEEPING and AWAKE entities are located in the sleeping pool.
      * 
-     * @tparam Cs... The components to iterate through.
+     * DEAD entities are removed from the system and are not updated. Their 
+     * information can still be accessed if the storage hasn't overwritten it or 
+     * that memory has not been freed, but this is undefined behavior.
      */
-    template <typename... Cs>
-    struct Iterator
-    {  
-        template <typename C>
-        using IteratorVector = std::vector<C>*;
-    
-        using IteratorData = std::tuple<IteratorVector<Cs>...>;
-    
-        private: 
-            std::vector<EntityId>* m_ids = nullptr;
-            IteratorData m_data;
-            size_t* m_end = nullptr;
-        
-            size_t m_current = 0;
-        
-            template <typename C>
-            auto extract_one() -> C&
-            {
-                return (*std::get<IteratorVector<C>>(m_data))[m_current];
-            }
-        
-            auto extract_all() -> Data<Cs&...>
-            {
-                return std::tie(extract_one<Cs>()...);
-            }
-        
-        public: 
-            Iterator() = default;
-        
-            Iterator(std::vector<EntityId>* _ids, IteratorData _data, size_t* _end)
-                : m_ids(_ids), m_data(_data), m_end(_end) {}
-                        
-            bool done() const { return m_current == *m_end; }
-        
-            bool empty() const { return *m_end == 0; }
-            
-            auto operator*() -> Extraction<Cs...>
-            {
-                return {(*m_ids)[m_current], extract_all()};
-            }
-        
-            bool operator!=(const Iterator<Cs...>& other) const 
-            {
-                return m_current != other.m_current;
-            }
-        
-            bool operator==(const Iterator<Cs...>& other) const 
-            {
-                return m_current == other.m_current;
-            }
-        
-            Iterator<Cs...>& operator++() 
-            {
-                ++m_current;
-                return *this;
-            }
-        
-            Iterator<Cs...>& begin() 
-            {
-                m_current = 0;
-                return *this;
-            }
-        
-            Iterator<Cs...>& end() 
-            {
-                m_current = *m_end;
-                return *this;
-            }
+    enum EntityState : uint8_t
+    {
+        LIVE, // The entity is ready to be used and can be killed or snoozed.
+        KILLED, // The entity has been marked for DEAD.
+        DEAD, // The entity cannot be used or read anymore.
+        SNOOZED, // The entity has been marked for SLEEP.
+        SLEEPING, // The entity is put to sleep, it can still be accessed, iterated and changed, but not killed.
+        AWAKE, // The entity is marked for LIVE.
     };
 
-    // ----------------------------------------------------------------------------
-    // Pool
-    // ---------------------------------------------------------------------------- 
+    // The total number of EntityStates.
+    const size_t STATE_COUNT = 6;
+
+    // Checks if an entity in this state is located in the sleeping pool.
+    inline bool is_sleeping(EntityState state)
+    {
+        return state == SLEEPING || state == AWAKE;
+    }
+
+    // A copy of an entity's metadata, assembled from the metadata arrays.
+    struct EntityInfo
+    {
+        ArchetypeId archetype = 0; // Index of the archetype in the registry's Archetypes.
+        PoolIndex index = -1; // Index of the entity in its pool.
+        EntityState state = LIVE;
+        Generation generation = 0; // Current generation of the entity's slot.
+    };
 
     /**
-     * Base archetype storage class.
-     * Contains functions for adding, removing and retrieving component data,
-     * as well as an iterator and utility functions.
+     * Entity metadata manager class. 
      * 
-     * The pool is always called on internally and is not exposed.
+     * Metadata is stored as parallel arrays indexed by slot (see id_slot), so 
+     * that lookups only touch the fields they need: the archetype id, the index 
+     * inside of the pool, the state and the slot's generation.
      * 
-     * @tparam A The archetype of the pool.
+     * It is always called on internally and is not exposed. 
      */
-    template <typename A>
-    class Pool
+    struct Entities 
     {
-        // A tuple of std::vector<C> for each component of the archetype.
-        using PoolData = WrapData<A, Data, std::vector>::type;
+        // ---- Entity data ---- //
 
-        size_t m_end = 0;
-        size_t m_total = 0;
-        PoolData m_data;
-        std::vector<EntityId> m_ids;
+        std::vector<ArchetypeId> archetypes; // Archetype id of every slot.
+        std::vector<PoolIndex> indices; // Pool index of every slot.
+        std::vector<EntityState> states; // State of every slot.
+        std::vector<Generation> generations; // Current generation of every slot.
 
-        template <typename C>
-        void push(C& component)
+        // ---- Counter ---- //
+
+        std::array<size_t, STATE_COUNT> counter = {}; // Holds the amount of entites available by state.
+
+        // ---- State management ---- //
+
+        size_t to_update_end = 0; 
+        std::vector<EntityId> to_update; // Ids to update by the registry.
+        std::vector<size_t> to_reuse; // Slots of dead entities that can be reused.
+
+        // The number of slots in use, including dead ones.
+        size_t size() const
         {
-            vector<C>().push_back(component);
+            return states.size();
         }
 
-        template <typename C>
-        void insert(C& component)        
+        // The bytes reserved by the metadata arrays and queues.
+        size_t memory() const
         {
-            vector<C>()[m_end] = component;
+            return archetypes.capacity() * sizeof(ArchetypeId) 
+                + indices.capacity() * sizeof(PoolIndex) 
+                + states.capacity() * sizeof(EntityState) 
+                + generations.capacity() * sizeof(Generation) 
+                + to_update.capacity() * sizeof(EntityId) 
+                + to_reuse.capacity() * sizeof(size_t);
         }
 
-        template <typename C>
-        void erase()
+        /**
+         * Writes the metadata arrays, the counters, the reusable slots and the 
+         * queued ids to a snapshot.
+         */
+        void save(std::ostream& out) const
         {
-            std::vector<C>& v = vector<C>();
-            v.erase(v.begin() + m_end, v.end());
-            m_total = m_end;
+            write_value<uint64_t>(out, size());
+            write_bytes(out, archetypes.data(), size());
+            write_bytes(out, indices.data(), size());
+            write_bytes(out, states.data(), size());
+            write_bytes(out, generations.data(), size());
+
+            for (size_t count : counter) write_value<uint64_t>(out, count);
+
+            write_value<uint64_t>(out, to_reuse.size());
+            for (size_t slot : to_reuse) write_value<uint64_t>(out, slot);
+
+            write_value<uint64_t>(out, to_update_end);
+            write_bytes(out, to_update.data(), to_update_end);
         }
 
-        template <typename C>
-        void swap(size_t index)
+        /**
+         * Replaces the metadata with the one of a snapshot.
+         * 
+         * @param archetype_count The number of archetypes of the registry.
+         * 
+         * @throws std::runtime_error If any field is out of range, the 
+         * counters do not match the states, the reusable slots are not 
+         * exactly the dead ones or the queued ids are not exactly the ones 
+         * waiting for an update.
+         */
+        void load(std::istream& in, size_t archetype_count)
         {
-            auto& v = vector<C>();
-            std::swap(v[index], v[m_end - 1]);
-        }
+            constexpr size_t slot_bytes = sizeof(ArchetypeId) + sizeof(PoolIndex) + sizeof(EntityState) + sizeof(Generation);
 
-        public: 
-            size_t total()
+            size_t count = read_length(in, slot_bytes, static_cast<size_t>(SLOT_MASK) + 1);
+
+            archetypes.resize(count);
+            indices.resize(count);
+            states.resize(count);
+            generations.resize(count);
+
+            read_bytes(in, archetypes.data(), count);
+            read_bytes(in, indices.data(), count);
+            read_bytes(in, states.data(), count);
+            read_bytes(in, generations.data(), count);
+
+            for (size_t& c : counter) c = read_value<uint64_t>(in);
+
+            to_reuse.resize(read_length(in, sizeof(uint64_t), count));
+            for (size_t& slot : to_reuse) slot = read_value<uint64_t>(in);
+
+            to_update_end = read_length(in, sizeof(EntityId));
+            to_update.resize(to_update_end);
+            read_bytes(in, to_update.data(), to_update_end);
+
+            std::array<size_t, STATE_COUNT> histogram = {};
+
+            for (size_t slot = 0; slot < count; slot++)
             {
-                return m_total;
+                if (archetypes[slot] >= archetype_count || states[slot] >= STATE_COUNT || generations[slot] > GENERATION_MASK)
+                {
+                    throw std::runtime_error("@Entities::load - snapshot holds invalid entity metadata.");
+                }
+
+                histogram[states[slot]]++;
             }
 
-            size_t count()
+            if (histogram != counter)
             {
-                return m_end;
+                throw std::runtime_error("@Entities::load - snapshot counters do not match the entity states.");
             }
 
-            template <typename... Cs>
-            void add(EntityId id, Data<Cs...> entity)
+            if (to_reuse.size() != counter[DEAD])
             {
-                if (m_end == m_total)
-                {
-                    (push<Cs>(std::get<Cs>(entity)),...);
-                    m_ids.push_back(id);
-                    m_total++;
-                }
-                else 
-                {
-                    (insert<Cs>(std::get<Cs>(entity)),...);
-                    m_ids[m_end] = id;
-                }
-
-                m_end++;
+                throw std::runtime_error("@Entities::load - snapshot does not reuse every dead slot.");
             }
 
-            void trim()
+            // A slot listed twice would be handed out to two entities.
+            std::vector<bool> seen(count);
+
+            for (size_t slot : to_reuse)
             {
-                [this]<typename... Cs>(Data<Cs...>)
-                {
-                    if (m_end < m_total)
-                    {
-                        m_ids.erase(m_ids.begin() + m_end, m_ids.end());
-                        ((erase<Cs>()),...);
-                    }
-                }
-                (A{});
+                if (slot >= count || states[slot] != DEAD) throw std::runtime_error("@Entities::load - snapshot reuses a slot that is not dead.");
+                if (seen[slot]) throw std::runtime_error("@Entities::load - snapshot reuses a slot twice.");
+
+                seen[slot] = true;
             }
 
-            auto ids() -> const std::vector<EntityId>&
+            if (to_update_end != counter[KILLED] + counter[SNOOZED] + counter[AWAKE])
             {
-                return m_ids;
+                throw std::runtime_error("@Entities::load - snapshot does not queue every pending entity.");
             }
 
-            template <typename C>
-            auto vector() -> std::vector<C>&
+            // Update moves every queued entity once, based on its pending state.
+            std::fill(seen.begin(), seen.end(), false);
+
+            for (EntityId id : to_update)
             {
-                return std::get<std::vector<C>>(m_data);
+                if (!is_current(id)) throw std::runtime_error("@Entities::load - snapshot queues an unknown entity.");
+
+                size_t slot = id_slot(id);
+                EntityState state = states[slot];
+
+                if (state != KILLED && state != SNOOZED && state != AWAKE) throw std::runtime_error("@Entities::load - snapshot queues an entity that is not pending.");
+                if (seen[slot]) throw std::runtime_error("@Entities::load - snapshot queues an entity twice.");
+
+                seen[slot] = true;
             }
+        }
 
-            auto get(size_t index)
-            {
-                return [this, &index]<typename... Cs>(Data<Cs...>)
-                {
-                    return get<Cs...>(index);
-                }
-                (A{});
+        // Checks if the handle refers to the current generation of its slot.
+        bool is_current(EntityId id) const
+        {
+            size_t slot = id_slot(id);
+            return slot < size() && generations[slot] == id_generation(id);
+        }
+
+        auto info(EntityId id) const -> EntityInfo
+        {
+            size_t slot = id_slot(id);
+            return {archetypes[slot], indices[slot], states[slot], generations[slot]};
+        }
+
+        void reserve(size_t count)
+        {
+            archetypes.reserve(count);
+            indices.reserve(count);
+            states.reserve(count);
+            generations.reserve(count);
+        }
+
+        /**
+         * Ties an id and metadata to a new entity. A dead entity's slot will be 
+         * reused if available.
+         * 
+         * @param info The new entity's metadata, the generation is ignored. 
+         * 
+         * @returns The new id. 
+         */
+        auto create(EntityInfo info) -> EntityId
+        {
+            if (to_reuse.size() > 0)
+            {   
+                counter[info.state]++;
+                counter[DEAD]--;
+                size_t slot = to_reuse.back();
+                to_reuse.pop_back();
+                archetypes[slot] = info.archetype;
+                indices[slot] = info.index;
+                states[slot] = info.state;
+                return make_id(slot, generations[slot]);
             }
-        
-            template <typename... Cs>
-            auto get(size_t index) -> Data<Cs&...>
+            else 
             {
-                return std::tie<Cs...>(vector<Cs>()[index]...);
+                size_t slot = size();
+                if (slot > SLOT_MASK) throw std::length_error("@Entities::create - out of entity slots.");
+                counter[info.state]++;
+                archetypes.push_back(info.archetype);
+                indices.push_back(info.index);
+                states.push_back(info.state);
+                generations.push_back(0);
+                return make_id(slot, 0);
             }
+        }
 
-            auto clone(size_t index)
-            {
-                return [this, &index]<typename... Cs>(Data<Cs...>)
-                {
-                    return clone<Cs...>(index);
-                }
-                (A{});
-            }    
+        /**
+         * Marks an entity's slot as free. The slot's generation is bumped so that
+         * every existing handle to it becomes stale.
+         * 
+         * @param id The dead entity.
+         */
+        void release(EntityId id)
+        {
+            size_t slot = id_slot(id);
+            generations[slot] = (generations[slot] + 1) & GENERATION_MASK;
+            to_reuse.push_back(slot);
+        }
 
-            template <typename... Cs>
-            auto clone(size_t index) -> Data<Cs...>
+        /**
+         * Kills an entity that was never handed out, like a creation that failed 
+         * halfway. Its slot is released right away.
+         * 
+         * @param id The entity to discard.
+         */
+        void discard(EntityId id)
+        {
+            EntityState& state = states[id_slot(id)];
+
+            counter[state]--;
+            counter[DEAD]++;
+            state = DEAD;
+            release(id);
+        }
+
+        /**
+         * Ties ids to a block of new entities. Dead slots are reused first, in 
+         * the same order as create takes them, and the rest of the block is 
+         * appended as new slots in one resize per array.
+         * 
+         * @param info The metadata of the first entity, the index is 
+         * incremented for every following entity.
+         * @param count The number of entities in the block.
+         * 
+         * @returns The ids of the block, in pool order.
+         */
+        auto create_block(EntityInfo info, size_t count) -> std::vector<EntityId>
+        {
+            size_t reused = std::min(count, to_reuse.size());
+            size_t first = size();
+            size_t fresh = count - reused;
+
+            if (first + fresh > static_cast<size_t>(SLOT_MASK) + 1) throw std::length_error("@Entities::create_block - out of entity slots.");
+
+            std::vector<EntityId> ids;
+            ids.reserve(count);
+
+            for (size_t i = 0; i < reused; i++)
             {
-                return get<Cs...>(index);
-            }    
-        
-            auto remove(size_t index) -> EntityId 
+                size_t slot = to_reuse.back();
+                to_reuse.pop_back();
+                archetypes[slot] = info.archetype;
+                indices[slot] = static_cast<PoolIndex>(info.index + i);
+                states[slot] = info.state;
+                ids.push_back(make_id(slot, generations[slot]));
+            }
+
+            archetypes.resize(first + fresh, info.archetype);
+            states.resize(first + fresh, info.state);
+            generations.resize(first + fresh, 0);
+            indices.resize(first + fresh);
+            std::iota(indices.begin() + first, indices.end(), static_cast<PoolIndex>(info.index + reused));
+
+            for (size_t slot = first; slot < first + fresh; slot++) ids.push_back(make_id(slot, 0));
+
+            counter[DEAD] -= reused;
+            counter[info.state] += count;
+
+            return ids;
+        }
+
+        /**
+         * Hands the queued entities over for an update and clears the queue. 
+         * Entities queued while the update runs go into a fresh queue.
+         * 
+         * @param out Receives the queued ids, its previous content is recycled 
+         * as the new queue.
+         * 
+         * @returns The number of queued ids at the front of out.
+         */
+        auto take_queue(std::vector<EntityId>& out) -> size_t
+        {
+            size_t count = to_update_end;
+            std::swap(to_update, out);
+            to_update_end = 0;
+            return count;
+        }
+
+        /**
+         * Queues an entity to be updated. 
+         * 
+         * @tparam Callback the type of the callback to be invoked.
+         * 
+         * @param id The entity to queue, stale handles are ignored.
+         * @param task The type of task to queue for. 
+         * @param callback The event callback to call on success.
+         */
+        template <typename Callback>
+        void queue(EntityId id, EntityTask task, Callback&& callback)
+        {
+            if (!is_current(id)) return;
+
+            EntityState& state = states[id_slot(id)];
+
+            EntityState req_state = 
+                task == KILL || task == SNOOZE
+                ? LIVE
+                : SLEEPING;
+                
+            EntityState res_state = 
+                task == KILL 
+                ? KILLED 
+                : task == SNOOZE
+                ? SNOOZED 
+                : AWAKE;
+
+            if (state == req_state)
             {
-                [this, &index]<typename... Cs>(Data<Cs...>)
+                if (to_update_end == to_update.size())
                 {
-                    (swap<Cs>(index),...);
-                    std::swap(m_ids[index], m_ids[m_end - 1]);
-                    m_end--;
+                    to_update.push_back(id);
                 }
-                (A{});
+                else 
+                {
+                    to_update[to_update_end] = id;
+                }   
 
-                return m_ids[index];
+                to_update_end++;
+                state = res_state;
+                counter[req_state]--;
+                counter[res_state]++;
+
+                callback(req_state, res_state);
             }
+        }
+    
+        /**
+         * Executes a state change for an entity instantly. 
+         * 
+         * @tparam Apply Must be invocable<EntityId>.
+         * 
+         * @param id The entity to change, stale handles are ignored.
+         * @param task The type of task to execute.
+         * @param apply Moves the entity into its new location.
+         */
+        template <typename Apply>
+        void execute(EntityId id, EntityTask task, Apply&& apply)
+        {
+            if (!is_current(id)) return;
 
-            template <typename... Cs>
-            auto iter() -> Iterator<Cs...>
-            {
-                auto ids_ptr = &m_ids;
-                auto end_ptr = &m_end;
-            
-                auto data = std::make_tuple(&vector<Cs>()...);
-            
-                return Iterator<Cs...>(ids_ptr, data, end_ptr);
+            EntityState& state = states[id_slot(id)];
+
+            EntityState req_state = 
+                task == KILL || task == SNOOZE
+                ? LIVE
+                : SLEEPING;
+                
+            EntityState res_state = 
+                task == KILL 
+                ? KILLED 
+                : task == SNOOZE
+                ? SNOOZED 
+                : AWAKE;
+
+            if (state == req_state)
+            { 
+                state = res_state;
+                counter[req_state]--;
+                counter[res_state]++;
+                apply(id);
             }
+        }
     };
 
+
     // ----------------------------------------------------------------------------
-    // Storage
+    // Listener & Event
     // ---------------------------------------------------------------------------- 
 
-    /**
-     * Storage metadata. 
-     * Contains a map of component -> bool. 
-     */
-    struct StorageInfo
-    {
-        // false by default
-        std::unordered_map<std::type_index, bool> components;
-        
-        template <typename... Cs>
-        StorageInfo(Data<Cs...> entity)
-        {
-            auto f = [this]<typename C>(C)
-            {
-                components[std::type_index(typeid(C))] = true;
-            };
-            (f(std::get<Cs>(entity)),...);
-        }
-    };
+    // Identifies a subscription to an event, see Registry::unsubscribe.
+    using Subscription = size_t;
 
     /**
-     * Top-level archetype container. 
+     * Event channel with any number of subscribers.
      * 
-     * Each storage contains a living and sleeping pool, as well as functions for 
-     * interacting with them. It also has some functions for applying updates to 
-     * an entity's state.
+     * Immediate subscribers take an E and are called as soon as the event is 
+     * fired. Batch subscribers take a std::span<const E>: events are queued in a 
+     * contiguous buffer instead and handed over all at once by 
+     * Registry::dispatch_events, which lets handlers run as plain loops. Events 
+     * are only queued while there is a batch subscriber. Empty events carry no 
+     * data and are coalesced into a single queued event per dispatch.
      * 
-     * Contains a map of component type_index -> bool.
+     * The listener is always called on internally and is not exposed.
      * 
-     * @tparam A The archetype of this storage.
+     * @tparam E The event to listen to.
      */
-    template <typename A>
-    struct Storage
-    {
-        Pool<A> living;
-        Pool<A> sleeping;
-        StorageInfo info = StorageInfo(A{});
+    template <typename E>
+    struct Listener 
+    {   
+        using Event = E;
+        using Callback = std::function<void(E)>;
+        using BatchCallback = std::function<void(std::span<const E>)>;
 
-        template <typename... Cs>
-        auto get(size_t index, bool sleeping_pool) -> Data<Cs&...>
-        {   
-            auto& data = sleeping_pool ? sleeping : living;
-            return data.template get<Cs...>(index);
-        }
+        bool ready = true; // is the channel open
+        std::vector<std::pair<Subscription, Callback>> callbacks; // called per event
+        std::vector<std::pair<Subscription, BatchCallback>> batch_callbacks; // called per dispatch
+        std::vector<E> queue; // events waiting for dispatch
 
-        template <typename... Cs>
-        auto iter(bool sleeping_pool) -> Iterator<Cs...>
+        // The bytes reserved by the subscribers and the queue, not counting captured state.
+        size_t memory() const
         {
-            auto& data = sleeping_pool ? sleeping : living;
-            return data.template iter<Cs...>();
+            return callbacks.capacity() * sizeof(callbacks[0]) 
+                + batch_callbacks.capacity() * sizeof(batch_callbacks[0]) 
+                + queue.capacity() * sizeof(E);
         }
 
-        auto pool(bool sleeping_pool) -> Pool<A>&
+        // Whether firing the event does anything at all.
+        bool is_active() const
         {
-            return sleeping_pool ? sleeping : living;
+            return ready && (!callbacks.empty() || !batch_callbacks.empty());
         }
-    };
-    
-    template <typename As>
-    using Storages = WrapData<As, Data, Storage>::type;
-
-    // ----------------------------------------------------------------------------
-    // Query
-    // ---------------------------------------------------------------------------- 
 
-    /**
-     * Main iterator class containing references to all the matching storages
-     * in the system.
-     */
-    template <typename... Cs>
-    class Query
-    {
-        struct Call 
+        void fire(const E& event)
         {
-            std::function<Iterator<Cs...>()> iter = {};
-        };
+            if (!callbacks.empty())
+            {
+                NECS_TRACE_SCOPE("Registry::call");
 
-        std::vector<Call> m_data;
-        Iterator<Cs...> m_iterator;
-        size_t m_current = 0;
-        bool m_sleeping_pool;
+                for (auto& [subscription, callback] : callbacks)
+                {
+                    callback(event);
+                }
+            }
+
+            if (batch_callbacks.empty()) return;
+
+            if constexpr (std::is_empty_v<E>)
+            {
+                if (queue.empty()) queue.push_back(event);
+            }
+            else 
+            {
+                queue.push_back(event);
+            }
+        }
 
-        void advance()
+        void dispatch()
         {
-            m_current++;
+            if (queue.empty()) return;
 
-            while (m_current < m_data.size())
+            // Handlers may fire more events of the same type, which are kept for the next dispatch.
+            std::vector<E> events;
+            events.swap(queue);
+
+            if (ready)
             {
-                m_iterator = m_data[m_current].iter();
-                
-                if (m_iterator.empty())
+                for (auto& [subscription, callback] : batch_callbacks)
                 {
-                    m_current++;
-                }
-                else 
-                {
-                    return;
+                    callback(std::span<const E>(events));
                 }
             }
+
+            events.clear();
+            if (queue.empty()) queue.swap(events);
         }
 
-        public: 
-            template <typename... As>
-            Query(Data<Storage<As>&...> storages, bool sleeping_pool) 
-            {
-                m_sleeping_pool = sleeping_pool;
+        bool remove(Subscription subscription)
+        {
+            auto matches = [&subscription](const auto& entry) { return entry.first == subscription; };
 
-                auto f = [this]<typename A>(Storage<A>& storage)
-                {
-                    Call call; 
+            size_t count = std::erase_if(callbacks, matches) + std::erase_if(batch_callbacks, matches);
 
-                    call.iter = [this, &storage] ()
-                    {
-                        return storage.template iter<Cs...>(m_sleeping_pool);
-                    };
+            if (batch_callbacks.empty()) queue.clear();
 
-                    m_data.push_back(call);
-                };
+            return count > 0;
+        }
+    };
 
-                ((f(std::get<Storage<As>&>(storages))),...);
+    // Empty, built-in templated event for A and C, fired whenever data moves around in the registry.
+    template <typename T>
+    struct DataUpdated {};
+    // Built-in event fired on entity creation. Contains the new entity's id.
+    struct EntityCreated { EntityId id; };
+    // Built-in event fired once per batch creation. Contains the ids of the batch, in creation order.
+    struct EntitiesCreated { std::vector<EntityId> ids; };
+    // Built-in event fired on state changes. Contains the id, the previous and new states.
+    struct EntityUpdated { EntityId id; EntityState prev_state; EntityState new_state; }; 
 
-                if (m_data.size() == 0)
-                {
-                    throw std::runtime_error("@Query::Query - no archetypes match. This query is redundant.");
-                }
-            };
+    /**
+     * Event policy observing every built-in event, the default of Registry. 
+     * A policy can also be a Data<Es...> of the built-in events to observe, 
+     * every other built-in event then compiles out: it has no listener and 
+     * firing it generates no code. Events declared by the user are always kept.
+     */
+    struct ObserveAll {};
 
-            size_t size()
-            {
-                return m_data.size();
-            }
+    // Event policy observing no built-in event.
+    using ObserveNone = Data<>;
 
-            auto chunk(size_t index) -> Iterator<Cs...>
-            {
-                return m_data[index].iter();
-            }
+    template <typename Observed, typename E>
+    struct IsObserved : Filter::has_type<E, Observed> {};
 
-           /** 
-            * Alternative to for loops.
-            * Iterates through all the storages in the system that match the components.
-            * 
-            * @tparam Cs... The components to filter for. 
-            * @tparam Callback Must be invocable<EntityId, Data<Cs&...>.
-            * 
-            * @param callback The callback to execute for each entity.
-            */
-            template <typename Callback>
-            void for_each(Callback&& callback)
-            {
-                static_assert(std::is_invocable_v<Callback, Extraction<Cs...>>, "For each callback must take Extraction<Cs...> as argument.");
+    template <typename E>
+    struct IsObserved<ObserveAll, E> : std::true_type {};
 
-                for (size_t i = 0; i < size(); i++)
-                {
-                    for (auto e : chunk(i))
-                    {
-                        callback(e);
-                    }
-                }
-            }
+    template <typename T>
+    auto InitBuiltInListeners()
+    {
+        return []<typename... As>(std::tuple<As...>) 
+        {
+            using UniqueComponents = typename Filter::merge_types<As...>::type;
 
-            bool operator!= (const Query<Cs...>& other) const 
-            {
-                return m_current != other.m_current;
-            }
-    
-            auto operator*() -> Extraction<Cs...>
-            {    
-                return *m_iterator;
-            }
-    
-            Query<Cs...>& operator++() 
-            {    
-                ++m_iterator;
-    
-                if (m_iterator.done()) advance();
-    
-                return *this;
-            }
+            return [] <typename... Cs> (std::tuple<Cs...>)
+            {   
+                return std::tuple
+                <
+                    Listener<EntityCreated>, 
+                    Listener<EntitiesCreated>, 
+                    Listener<EntityUpdated>, 
+                    Listener<DataUpdated<As>>..., 
+                    Listener<DataUpdated<Cs>>...
+                >{};
+            } 
+            (UniqueComponents{});
+        }
+        (T{});
+    }
 
-            Query<Cs...>& begin() 
+    template <typename As, typename Es, typename Observed>
+    auto InitListeners()
+    {
+        return [] <typename... Ts>(std::tuple<Ts...>)
+        {
+            using BuiltInEvents = std::invoke_result_t<decltype(InitBuiltInListeners<As>)>;
+            using GameEvents = std::tuple<Listener<Ts>...>;
+
+            using ObservedEvents = decltype([]<typename... Ls>(std::tuple<Ls...>)
             {
-                m_current = 0;
-    
-                m_iterator = m_data[m_current].iter();
-        
-                if (m_iterator.empty()) advance();
-    
-                return *this;
+                return std::tuple_cat
+                (
+                    std::conditional_t
+                    <
+                        IsObserved<Observed, typename Ls::Event>::value, 
+                        std::tuple<Ls>, 
+                        std::tuple<>
+                    >{}...
+                );
             }
+            (BuiltInEvents{}));
+
+            return std::tuple_cat(ObservedEvents{}, GameEvents{});
+        }
+        (Es{});
+    }
     
-            Query<Cs...>& end() 
-            {
-                m_current = m_data.size();
-    
-                return *this;
-            }    
-    };  
+    template <typename As, typename Es, typename Observed = ObserveAll>
+    using Listeners = std::invoke_result_t<decltype(InitListeners<As, Es, Observed>)>;
 
     // ----------------------------------------------------------------------------
-    // Debug
+    // Memory
     // ---------------------------------------------------------------------------- 
 
+    // The size of a transparent huge page on x86-64 and most aarch64 kernels.
+    const size_t HUGE_PAGE_SIZE = size_t(2) << 20;
+
+    /**
+     * Memory resource for large pools.
+     * 
+     * Allocations of at least threshold bytes are mapped directly and, on Linux,
+     * marked with madvise(MADV_HUGEPAGE) so that the kernel backs them with 
+     * transparent huge pages. This cuts TLB misses when iterating over columns 
+     * of millions of entities. Smaller allocations and other platforms fall back 
+     * to the upstream resource.
+     * 
+     * The resource is stateless apart from its settings and is thread-safe 
+     * as long as the upstream resource is.
+     */
+    class HugePageResource : public std::pmr::memory_resource
+    {
+        size_t m_threshold;
+        std::pmr::memory_resource* m_upstream;
+
+        static size_t mapped_size(size_t bytes)
+        {
+            return (bytes + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+        }
+
+        bool is_mapped(size_t bytes, size_t alignment) const
+        {
+            #if defined(__linux__) && defined(MADV_HUGEPAGE)
+                return bytes >= m_threshold && alignment <= HUGE_PAGE_SIZE;
+            #else 
+                (void)bytes; (void)alignment;
+                return false;
+            #endif
+        }
+
+        void* do_allocate(size_t bytes, size_t alignment) override
+        {
+            if (!is_mapped(bytes, alignment)) return m_upstream->allocate(bytes, alignment);
+
+            #if defined(__linux__) && defined(MADV_HUGEPAGE)
+                size_t size = mapped_size(bytes);
+
+                // Over-allocate by one huge page so the block can start on a huge page boundary.
+                void* region = mmap(nullptr, size + HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+                if (region == MAP_FAILED) throw std::bad_alloc();
+
+                uintptr_t start = reinterpret_cast<uintptr_t>(region);
+                uintptr_t aligned = (start + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1);
+                size_t head = aligned - start;
+
+                if (head > 0) munmap(region, head);
+                munmap(reinterpret_cast<void*>(aligned + size), HUGE_PAGE_SIZE - head);
+
+                madvise(reinterpret_cast<void*>(aligned), size, MADV_HUGEPAGE);
+
+                return reinterpret_cast<void*>(aligned);
+            #else 
+                return nullptr;
+            #endif
+        }
+
+        void do_deallocate(void* p, size_t bytes, size_t alignment) override
+        {
+            if (!is_mapped(bytes, alignment)) return m_upstream->deallocate(p, bytes, alignment);
+
+            #if defined(__linux__) && defined(MADV_HUGEPAGE)
+                munmap(p, mapped_size(bytes));
+            #endif
+        }
+
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+        {
+            return this == &other;
+        }
+
+        public: 
+            /**
+             * @param threshold The smallest allocation in bytes to map with huge pages.
+             * @param upstream The resource used for smaller allocations.
+             */
+            HugePageResource
+            (
+                size_t threshold = HUGE_PAGE_SIZE, 
+                std::pmr::memory_resource* upstream = std::pmr::new_delete_resource()
+            ) 
+                : m_threshold(threshold), m_upstream(upstream) {}
+    };
+
+    /**
+     * Storage policy of an archetype's pools. 
+     * 
+     * By default (0) columns are contiguous and grow like vectors, which relocates 
+     * every component when capacity runs out. Specialize it with a power of two to 
+     * store the archetype in fixed-size blocks of that many entities instead: growth 
+     * then only allocates a new block, so adding entities never moves components.
+     * 
+     * Addresses only survive growth. Pools stay packed, so removing, snoozing or 
+     * waking an entity moves the pool's last entity into its slot, or every later 
+     * entity with update(true). Sorting and set_resource move entities as well.
+     * 
+     * template <> struct NECS::BlockSize<Monster> : std::integral_constant<size_t, 16384> {};
+     * 
+     * @tparam A The archetype.
+     */
+    template <typename A>
+    struct BlockSize : std::integral_constant<size_t, 0> {};
+
+    /**
+     * Rules for giving pool memory back automatically, applied by 
+     * Registry::update. Every rule is disabled by default.
+     * 
+     * Shrinking a pool drops its dead slots and releases the capacity its 
+     * entities do not use, so the resident memory of a long-lived process 
+     * follows its live entity count after a spike.
+     */
+    struct TrimPolicy
+    {
+        // Shrink a pool once its entities fill less than this fraction of its capacity, 0 to disable.
+        double shrink_below = 0;
+        // Pools with at most this many slots of capacity are left alone by shrink_below.
+        size_t min_capacity = 1024;
+        // The number of pools checked for shrink_below per update, spreading the cost over frames. 0 checks all.
+        size_t pools_per_update = 0;
+        // The number of bytes all pools may reserve, pools with the most unused memory are shrunk first. 0 to disable.
+        size_t memory_budget = 0;
+    };
+
+    /**
+     * Components that own heap memory can report it with a heap_size() member, 
+     * which Registry::memory_report adds up per column. Only columns of such 
+     * components are walked, every other number in a report is read from 
+     * capacities.
+     */
     template <typename C>
-    concept Debuggable = requires(const C& component) 
+    concept HeapSized = requires(const C& component) 
     {
-        { component.debug() };
+        { component.heap_size() } -> std::convertible_to<size_t>;
+    };
+
+    // Memory of one column of a pool.
+    struct ColumnReport
+    {
+        const char* name = ""; // The type name of the component.
+        size_t size = 0; // Constructed elements, including dead slots.
+        size_t capacity = 0;
+        size_t bytes = 0; // Bytes reserved for elements.
+        size_t heap_bytes = 0; // Heap owned by the elements, HeapSized components only.
+    };
+
+    // Memory of one pool.
+    struct PoolReport
+    {
+        size_t count = 0; // Iterable entities.
+        size_t dead = 0; // Constructed slots past the iterable entities.
+        size_t capacity = 0;
+        size_t bytes = 0; // Bytes reserved by the columns, ids and change ticks.
+        size_t heap_bytes = 0;
+        std::vector<ColumnReport> columns;
+    };
+
+    // Memory of both pools of an archetype.
+    struct ArchetypeReport
+    {
+        const char* name = ""; // The type name of the archetype.
+        PoolReport living;
+        PoolReport sleeping;
     };
 
     /**
-     * Allows open access to entity data in development. 
-     *
-     * Prints debug logs for entities + components if their components are Debbugable. 
-     * Since all the data is public, custom logs can be easily implemented externally.
+     * Breakdown of the memory used by a registry, see Registry::memory_report.
      */
-    template <typename... As>
-    struct Debugger 
+    struct MemoryReport
     {
-        Entities& entities;
-        std::tuple<Storage<As>...>& storages;
+        std::vector<ArchetypeReport> archetypes; // By archetype id.
+        size_t pool_bytes = 0; // Reserved by every pool.
+        size_t heap_bytes = 0; // Owned by HeapSized components.
+        size_t metadata_bytes = 0; // Entity metadata and update queues.
+        size_t slots = 0; // Entity metadata slots, including dead ones.
+        size_t reusable_slots = 0; // Dead slots waiting to be reused.
+        size_t event_bytes = 0; // Subscribers and queued events.
+        size_t command_bytes = 0; // Command buffers.
+
+        size_t total() const
+        {
+            return pool_bytes + heap_bytes + metadata_bytes + event_bytes + command_bytes;
+        }
+    };
 
-        bool sleeping_pool = false;
+    /**
+     * Gets the peak resident set size of the process in bytes, through 
+     * getrusage. Returns 0 on platforms without it.
+     */
+    inline size_t peak_rss()
+    {
+#if defined(__unix__) || defined(__APPLE__)
+        rusage usage = {};
+        getrusage(RUSAGE_SELF, &usage);
+#if defined(__APPLE__)
+        return static_cast<size_t>(usage.ru_maxrss);
+#else
+        return static_cast<size_t>(usage.ru_maxrss) * 1024;
+#endif
+#else
+        return 0;
+#endif
+    }
 
-        template <typename A>
-        auto storage() -> Storage<A>&
+    // The assumed size of a cache line in bytes.
+    const size_t CACHE_LINE = 64;
+
+    /**
+     * Allocator of column blocks. Allocates from a memory resource like 
+     * std::pmr::polymorphic_allocator does, but aligned to a cache line, so 
+     * that ranges of a block spanning whole cache lines share none with their 
+     * neighbours.
+     * 
+     * @tparam T The allocated type.
+     */
+    template <typename T>
+    struct LineAllocator
+    {
+        using value_type = T;
+
+        static constexpr size_t alignment = std::max(alignof(T), CACHE_LINE);
+
+        std::pmr::memory_resource* resource = std::pmr::get_default_resource();
+
+        LineAllocator() = default;
+
+        LineAllocator(std::pmr::memory_resource* resource) : resource(resource) {}
+
+        template <typename U>
+        LineAllocator(const LineAllocator<U>& other) : resource(other.resource) {}
+
+        T* allocate(size_t count)
         {
-            return std::get<Storage<A>>(storages);
+            return static_cast<T*>(resource->allocate(count * sizeof(T), alignment));
         }
 
-        template <typename A>
-        bool is_type(EntityId id) 
+        void deallocate(T* p, size_t count)
         {
-            return info(id).type == std::type_index(typeid(A));
+            resource->deallocate(p, count * sizeof(T), alignment);
         }
 
-        auto info(EntityId id) -> const EntityInfo& 
+        template <typename U>
+        bool operator==(const LineAllocator<U>& other) const
         {
-            return entities.data[id].info;
+            return resource == other.resource || resource->is_equal(*other.resource);
         }
+    };
 
-        template <typename A>
-        auto view_entity(EntityId id)
+    /**
+     * Storage type of a single component column, and of the ids of a pool.
+     * 
+     * A column is a list of blocks allocated through the memory resource of its 
+     * pool, every block starting on a cache line. In contiguous mode there is a single block that grows as needed, in 
+     * chunked mode every block holds a fixed power of two of elements and is never
+     * reallocated. Indexing is the same in both modes: the block is index >> shift 
+     * and the offset in it is index & mask, with a shift that leaves every index 
+     * in block 0 for contiguous columns.
+     * 
+     * @tparam T The stored type.
+     */
+    template <typename T>
+    class Column
+    {
+        using Block = std::vector<T, LineAllocator<T>>;
+
+        std::pmr::vector<Block> m_blocks;
+        T* m_data = nullptr; // The single block of a contiguous column, indexed without the block table.
+        size_t m_size = 0;
+        size_t m_block_size = 0;
+        size_t m_shift = 63;
+        size_t m_mask = ~size_t(0);
+
+        auto add_block() -> Block&
         {
-            return [this, &id]<typename... Cs>(Data<Cs...>)
-            {
-                return view_components<A, Cs...>(id);
-            }
-            (A{});
+            Block& block = m_blocks.emplace_back(resource());
+            block.reserve(m_block_size);
+            return block;
         }
 
-        template <typename A, typename... Cs>
-        auto view_components(EntityId id) -> View<Cs...>
+        // Refreshes m_data after the single block of a contiguous column may have reallocated.
+        void track()
         {
-            auto& i = info(id);
+            if (!is_chunked()) m_data = m_blocks[0].data();
+        }
 
-            if (i.state == DEAD || !is_type<A>(id))
+        // Makes sure the block that index falls into exists.
+        void prepare(size_t index)
+        {
+            if ((index >> m_shift) == m_blocks.size()) add_block();
+        }
+
+        public: 
+            /**
+             * @param resource The resource to allocate blocks from.
+             * @param block_size 0 for a contiguous column, a power of two for a chunked one.
+             */
+            Column
+            (
+                std::pmr::memory_resource* resource = std::pmr::get_default_resource(), 
+                size_t block_size = 0
+            ) 
+                : m_blocks(resource), m_block_size(block_size)
             {
-                return std::nullopt;
+                if (block_size == 0)
+                {
+                    m_blocks.emplace_back(resource);
+                    track();
+                    return;
+                }
+
+                if ((block_size & (block_size - 1)) != 0)
+                {
+                    throw std::invalid_argument("@Column::Column - block size must be a power of two.");
+                }
+
+                m_shift = std::countr_zero(block_size);
+                m_mask = block_size - 1;
             }
 
-            return storage<A>().template get<Cs...>(i.index, (i.state == SLEEPING || i.state == AWAKE));
-        }
-        
-        template <typename A>
-        void print_entity(EntityId id) 
-        {
-            if (!is_type<A>(id))
+            Column(const Column& other) 
+                : m_blocks(other.m_blocks), m_size(other.m_size), m_block_size(other.m_block_size), 
+                  m_shift(other.m_shift), m_mask(other.m_mask)
             {
-                std::cout << "----------------------------------------\n";
-                std::cout << "|---INCORRECT TYPE---|\n";
-                std::cout << "----------------------------------------\n";       
-                return;         
+                track();
             }
 
-            auto e = view_entity<A>(id);
+            // Moving keeps the blocks in place, so m_data stays valid.
+            Column(Column&& other) noexcept = default;
 
-            if (!e.has_value())
+            Column& operator=(const Column& other)
             {
-                std::cout << "----------------------------------------\n";
-                std::cout << "|---NOT FOUND---|\n";
-                std::cout << "----------------------------------------\n";       
-                return;         
+                m_blocks = other.m_blocks;
+                m_size = other.m_size;
+                m_block_size = other.m_block_size;
+                m_shift = other.m_shift;
+                m_mask = other.m_mask;
+                track();
+                return *this;
             }
 
-            auto& i = info(id);
-            auto state = [&i]()
+            // Blocks are copied when the resources differ, so m_data is refreshed.
+            Column& operator=(Column&& other)
             {
-                switch(i.state)
-                {
-                    case LIVE: return "LIVE";
-                    case DEAD: return "DEAD";
-                    case SLEEPING: return "SLEEPING";
-                    case KILLED: return "KILLED";
-                    case SNOOZED: return "SNOOZED";
-                    case AWAKE: return "AWAKE";
-                    default: return "ERROR";
+                m_blocks = std::move(other.m_blocks);
+                m_size = other.m_size;
+                m_block_size = other.m_block_size;
+                m_shift = other.m_shift;
+                m_mask = other.m_mask;
+                track();
+                return *this;
+            }
+
+            bool is_chunked() const { return m_block_size != 0; }
+
+            size_t size() const { return m_size; }
+
+            size_t block_size() const { return m_block_size; }
+
+            auto resource() const -> std::pmr::memory_resource*
+            {
+                return m_blocks.get_allocator().resource();
+            }
+
+            size_t capacity() const 
+            {
+                return is_chunked() ? m_blocks.size() * m_block_size : m_blocks[0].capacity();
+            }
+
+            T& operator[](size_t index) 
+            { 
+                return is_chunked() ? m_blocks[index >> m_shift][index & m_mask] : m_data[index]; 
+            }
+
+            const T& operator[](size_t index) const 
+            { 
+                return is_chunked() ? m_blocks[index >> m_shift][index & m_mask] : m_data[index]; 
+            }
+
+            /**
+             * Random access iterator over the elements of a column, across blocks.
+             * 
+             * @tparam Const Whether the elements are read-only.
+             */
+            template <bool Const>
+            struct Cursor
+            {
+                using iterator_category = std::random_access_iterator_tag;
+                using value_type = T;
+                using difference_type = std::ptrdiff_t;
+                using pointer = std::conditional_t<Const, const T*, T*>;
+                using reference = std::conditional_t<Const, const T&, T&>;
+
+                std::conditional_t<Const, const Column*, Column*> column = nullptr;
+                size_t index = 0;
+
+                reference operator*() const { return (*column)[index]; }
+                pointer operator->() const { return &(*column)[index]; }
+                reference operator[](difference_type n) const { return (*column)[index + n]; }
+
+                Cursor& operator++() { ++index; return *this; }
+                Cursor operator++(int) { Cursor c = *this; ++index; return c; }
+                Cursor& operator--() { --index; return *this; }
+                Cursor operator--(int) { Cursor c = *this; --index; return c; }
+                Cursor& operator+=(difference_type n) { index += n; return *this; }
+                Cursor& operator-=(difference_type n) { index -= n; return *this; }
+
+                friend Cursor operator+(Cursor c, difference_type n) { return c += n; }
+                friend Cursor operator+(difference_type n, Cursor c) { return c += n; }
+                friend Cursor operator-(Cursor c, difference_type n) { return c -= n; }
+                friend difference_type operator-(const Cursor& a, const Cursor& b) 
+                { 
+                    return static_cast<difference_type>(a.index) - static_cast<difference_type>(b.index); 
                 }
+
+                friend bool operator==(const Cursor& a, const Cursor& b) { return a.index == b.index; }
+                friend auto operator<=>(const Cursor& a, const Cursor& b) { return a.index <=> b.index; }
             };
-            
-            std::cout << "----------------------------------------\n";
-            std::cout << "Entity ID: " << id
-                        << " (Index: " << i.index
-                        << ", State: " << state() << ")\n";
-            std::cout << "Components:\n";
 
-            auto f = [this]<typename C>(C& component)
+            auto begin() -> Cursor<false> { return {this, 0}; }
+            auto end() -> Cursor<false> { return {this, m_size}; }
+            auto begin() const -> Cursor<true> { return {this, 0}; }
+            auto end() const -> Cursor<true> { return {this, m_size}; }
+
+            // ---- Blocks ---- //
+
+            // The number of blocks holding the first count elements.
+            size_t block_count(size_t count) const 
             {
-                if constexpr (Debuggable<C>)
+                return count == 0 ? 0 : ((count - 1) >> m_shift) + 1;
+            }
+
+            size_t block_of(size_t index) const { return index >> m_shift; }
+
+            // The index of the first element of a block.
+            size_t block_begin(size_t block) const { return block << m_shift; }
+
+            // One past the last element of a block.
+            size_t block_end(size_t block) const { return block_begin(block) + m_blocks[block].size(); }
+
+            /**
+             * Gets a block as a contiguous span, clipped to the first count elements 
+             * of the column.
+             */
+            auto block(size_t block, size_t count) -> std::span<T>
+            {
+                return {m_blocks[block].data(), std::min(count, block_end(block)) - block_begin(block)};
+            }
+
+            // ---- Modifiers ---- //
+
+            template <typename... Args>
+            T& emplace_back(Args&&... args)
+            {
+                prepare(m_size);
+                T& value = m_blocks[m_size >> m_shift].emplace_back(std::forward<Args>(args)...);
+                m_size++;
+                track();
+                return value;
+            }
+
+            // Appends count copies of a value, block by block.
+            void append(size_t count, const T& value)
+            {
+                while (count > 0)
                 {
-                    component.debug();
-                    std::cout << "\n";
+                    prepare(m_size);
+
+                    Block& block = m_blocks[m_size >> m_shift];
+                    size_t taken = is_chunked() ? std::min(count, m_block_size - block.size()) : count;
+
+                    block.insert(block.end(), taken, value);
+                    m_size += taken;
+                    count -= taken;
                 }
-                else
+
+                track();
+            }
+
+            void reserve(size_t count)
+            {
+                if (!is_chunked()) 
                 {
-                    std::cout << "  - " << typeid(C).name() << ":";
-                    std::cout << "<not implemented>\n";
+                    m_blocks[0].reserve(count);
+                    track();
+                    return;
                 }
-            };
 
-            [this, &f]<typename... Cs>(Data<Cs&...> entity)
+                while (capacity() < count) add_block();
+            }
+
+            // Releases the capacity beyond the elements. Blocks keep their size, empty ones are freed.
+            void shrink_to_fit()
             {
-                (f(std::get<Cs&>(entity)),...);
+                if (!is_chunked())
+                {
+                    m_blocks[0].shrink_to_fit();
+                    track();
+                    return;
+                }
+
+                size_t blocks = std::max<size_t>(block_count(m_size), 1);
+
+                while (m_blocks.size() > blocks) m_blocks.pop_back();
+
+                m_blocks.shrink_to_fit();
             }
-            (e.value());
 
-            std::cout << "----------------------------------------\n";
-        };
+            /**
+             * Writes the first count elements to a snapshot, as one raw block of 
+             * memory per column block if they are trivially copyable.
+             */
+            void save(std::ostream& out, size_t count) requires Serializable<T>
+            {
+                if constexpr (std::is_trivially_copyable_v<T>)
+                {
+                    for (size_t b = 0; b < block_count(count); b++)
+                    {
+                        std::span<T> data = block(b, count);
+                        write_bytes(out, data.data(), data.size());
+                    }
+                }
+                else 
+                {
+                    for (size_t i = 0; i < count; i++) write_value(out, (*this)[i]);
+                }
+            }
 
-        template <typename A>
-        void print_storage(std::string archetype_name = typeid(A).name()) 
+            /**
+             * Appends count elements read from a snapshot. Trivially copyable 
+             * elements are read straight into the blocks.
+             */
+            void load(std::istream& in, size_t count) requires Serializable<T>
+            {
+                static_assert(std::is_default_constructible_v<T>, "@Column::load: Loaded components must be default constructible.");
+
+                size_t first = m_size;
+
+                reserve(first + count);
+                append(count, T{});
+
+                if constexpr (std::is_trivially_copyable_v<T>)
+                {
+                    for (size_t b = block_of(first); b < block_count(m_size); b++)
+                    {
+                        std::span<T> data = block(b, m_size);
+                        size_t skip = b == block_of(first) ? first - block_begin(b) : 0;
+                        read_bytes(in, data.data() + skip, data.size() - skip);
+                    }
+                }
+                else 
+                {
+                    for (size_t i = first; i < m_size; i++) read_value(in, (*this)[i]);
+                }
+            }
+
+            // Destroys every element from count on, releasing the blocks that become empty.
+            void truncate(size_t count)
+            {
+                if (count >= m_size) return;
+
+                size_t blocks = std::max<size_t>(block_count(count), 1);
+
+                while (m_blocks.size() > blocks) m_blocks.pop_back();
+
+                Block& last = m_blocks.back();
+                last.erase(last.begin() + (count - block_begin(m_blocks.size() - 1)), last.end());
+
+                m_size = count;
+            }
+    };
+
+    // A change tick, see Registry::tick.
+    using Tick = uint32_t;
+
+    // Tag for the ticks at which entities were added to a pool, see Registry::query_added.
+    struct Added {};
+
+    // Entities share a chunk tick in groups of 1 << TICK_CHUNK_SHIFT, or of a block if blocks are smaller.
+    const size_t TICK_CHUNK_SHIFT = 8;
+
+    /**
+     * Change ticks of one column of a pool. 
+     * 
+     * Every entity has the tick of its last change and every chunk of entities 
+     * has the highest tick of its entities, so that unchanged chunks can be 
+     * skipped without reading the entity ticks. Chunk ticks are never lowered,
+     * they are an upper bound.
+     */
+    class Ticks
+    {
+        Column<Tick> m_entities;
+        std::pmr::vector<Tick> m_chunks;
+        size_t m_shift;
+
+        void resize_chunks(size_t count)
         {
-            Storage<A>& s = storage<A>();
+            m_chunks.resize(count == 0 ? 0 : ((count - 1) >> m_shift) + 1, 0);
+        }
 
-            Pool<A>& pool = sleeping_pool ? s.sleeping : s.living;
+        public: 
+            /**
+             * @param resource The resource of the pool's columns.
+             * @param block_size The block size of the pool's columns.
+             */
+            Ticks(std::pmr::memory_resource* resource = std::pmr::get_default_resource(), size_t block_size = 0) 
+                : m_entities(resource, block_size), m_chunks(resource),
+                  m_shift(block_size == 0 ? TICK_CHUNK_SHIFT : std::min<size_t>(TICK_CHUNK_SHIFT, std::countr_zero(block_size))) {}
 
-            std::cout << "\n[Archetype: " << archetype_name << "]";
-            std::cout << "\n[Storage type: " << (sleeping_pool ? "Sleeping" : "Living") << "]\n";
+            size_t chunk_shift() const { return m_shift; }
 
-            if (pool.count() == 0) 
+            auto resource() const -> std::pmr::memory_resource*
+            {
+                return m_chunks.get_allocator().resource();
+            }
+
+            Tick entity(size_t index) const { return m_entities[index]; }
+
+            Tick chunk(size_t chunk) const { return m_chunks[chunk]; }
+
+            /**
+             * Stamps an entity with a tick. 
+             * Safe to call concurrently for different entities.
+             */
+            void set(size_t index, Tick tick)
+            {
+                m_entities[index] = tick;
+
+                std::atomic_ref<Tick> chunk(m_chunks[index >> m_shift]);
+
+                if (chunk.load(std::memory_order_relaxed) < tick) 
+                {
+                    chunk.store(tick, std::memory_order_relaxed);
+                }
+            }
+
+            /**
+             * Stamps the entities from begin to end with a tick, one chunk tick 
+             * update per chunk. Safe to call concurrently for disjoint ranges.
+             */
+            void stamp(size_t begin, size_t end, Tick tick)
+            {
+                if (begin >= end) return;
+
+                for (size_t index = begin; index < end; index++) m_entities[index] = tick;
+
+                for (size_t chunk = begin >> m_shift; chunk <= (end - 1) >> m_shift; chunk++)
+                {
+                    std::atomic_ref<Tick> c(m_chunks[chunk]);
+
+                    if (c.load(std::memory_order_relaxed) < tick) c.store(tick, std::memory_order_relaxed);
+                }
+            }
+
+            // Appends count entities stamped with a tick.
+            void append(size_t count, Tick tick)
+            {
+                if (count == 0) return;
+
+                size_t first = m_entities.size();
+
+                m_entities.append(count, tick);
+                resize_chunks(m_entities.size());
+
+                for (size_t chunk = first >> m_shift; chunk < m_chunks.size(); chunk++)
+                {
+                    m_chunks[chunk] = std::max(m_chunks[chunk], tick);
+                }
+            }
+
+            // Carries the tick of a moved entity over to its new slot.
+            void move(size_t from, size_t to)
+            {
+                set(to, m_entities[from]);
+            }
+
+            // Reorders the ticks of the first order.size() entities, the entity at order[i] moves to i.
+            void permute(std::span<const size_t> order)
+            {
+                std::vector<Tick> ticks(order.size());
+
+                for (size_t i = 0; i < order.size(); i++) ticks[i] = m_entities[order[i]];
+                for (size_t i = 0; i < order.size(); i++) set(i, ticks[i]);
+            }
+
+            void truncate(size_t count)
+            {
+                m_entities.truncate(count);
+                resize_chunks(count);
+            }
+
+            void shrink_to_fit()
+            {
+                m_entities.shrink_to_fit();
+                m_chunks.shrink_to_fit();
+            }
+
+            size_t memory() const
+            {
+                return m_entities.capacity() * sizeof(Tick) + m_chunks.capacity() * sizeof(Tick);
+            }
+
+            // Moves the ticks into memory from another resource, capacity is kept.
+            void set_resource(std::pmr::memory_resource* resource)
+            {
+                Column<Tick> entities(resource, m_entities.block_size());
+                std::pmr::vector<Tick> chunks(resource);
+
+                entities.reserve(m_entities.capacity());
+                chunks.reserve(m_chunks.capacity());
+
+                for (size_t i = 0; i < m_entities.size(); i++) entities.emplace_back(m_entities[i]);
+                chunks.assign(m_chunks.begin(), m_chunks.end());
+
+                // Polymorphic allocators do not propagate on move assignment, rebuild instead.
+                std::destroy_at(&m_entities);
+                std::construct_at(&m_entities, std::move(entities));
+                std::destroy_at(&m_chunks);
+                std::construct_at(&m_chunks, std::move(chunks));
+            }
+    };
+
+    // ----------------------------------------------------------------------------
+    // Extraction
+    // ---------------------------------------------------------------------------- 
+
+    /**
+     * Type returned by iterators and queries.
+     * Pair consisting of an EntityId copy and a tuple of component references.
+     * 
+     * @tparam Cs... The extracted components.
+     */
+    template <typename... Cs>
+    using Extraction = std::pair<EntityId, Data<Cs&...>>;
+
+    // ----------------------------------------------------------------------------
+    // Iterator
+    // ---------------------------------------------------------------------------- 
+    
+    /**
+     * A pool-level iterator.
+     * 
+     * It contains references to the desired component columns. 
+     * Since storages & their pools exist for the entire duration of the program, 
+     * it can safely hold references to the storage's data indefinitely.
+     * 
+     * Iteration goes block by block: the iterator keeps pointers into the current 
+     * block of every column, so stepping through a block is plain pointer access.
+     * 
+     * The block is only reloaded when the iterator steps past its end, so the 
+     * pool must not change structurally in the middle of a block:
+     * 
+     * - Entities created while iterating are visited once their block is 
+     *   reached. This is only safe when the columns do not reallocate, that is 
+     *   in chunked pools (see BlockSize) or after reserving enough capacity.
+     * - Entities must not be killed, snoozed, woken, sorted or trimmed while 
+     *   iterating their pool, record those changes with commands instead and 
+     *   flush them after the loop.
+     * 
+     * Dereferencing stamps the change ticks of the entity's mutable components, 
+     * so a loop only marks the entities it actually visits.
+     * 
+     * @tparam Cs... The components to iterate through.
+     */
+    template <typename... Cs>
+    struct Iterator
+    {  
+        // Const components are read from the same columns as mutable ones.
+        template <typename C>
+        using IteratorVector = Column<std::remove_const_t<C>>*;
+    
+        using IteratorData = std::tuple<IteratorVector<Cs>...>;
+    
+        private: 
+            Column<EntityId>* m_ids = nullptr;
+            IteratorData m_data;
+            size_t* m_end = nullptr;
+            std::array<Ticks*, sizeof...(Cs)> m_ticks = {}; // Change ticks of every component, null for const ones.
+            const Tick* m_clock = nullptr;
+        
+            // The current block: the pool index of its start, the offset in it, its length and its data.
+            size_t m_block_begin = 0;
+            size_t m_offset = 0;
+            size_t m_length = 0;
+            const EntityId* m_block_ids = nullptr;
+            std::tuple<Cs*...> m_block;
+
+            // Points the block cache at the block holding a pool index.
+            void load(size_t index)
+            {
+                size_t block = m_ids->block_of(index);
+                std::span<const EntityId> ids = m_ids->block(block, *m_end);
+
+                m_block_begin = m_ids->block_begin(block);
+                m_offset = index - m_block_begin;
+                m_length = ids.size();
+                m_block_ids = ids.data();
+                m_block = {std::get<IteratorVector<Cs>>(m_data)->block(block, *m_end).data()...};
+            }
+        
+            auto extract_all() -> Data<Cs&...>
+            {
+                return std::tie(std::get<Cs*>(m_block)[m_offset]...);
+            }
+        
+        public: 
+            Iterator() = default;
+        
+            Iterator
+            (
+                Column<EntityId>* _ids, IteratorData _data, size_t* _end, 
+                std::array<Ticks*, sizeof...(Cs)> _ticks = {}, const Tick* _clock = nullptr
+            )
+                : m_ids(_ids), m_data(_data), m_end(_end), m_ticks(_ticks), m_clock(_clock) {}
+
+            /**
+             * Stamps the mutable components of the entities from begin to end as 
+             * changed at the current tick. Does nothing without a clock or 
+             * mutable components.
+             */
+            void stamp(size_t begin, size_t end) const
+            {
+                if (!m_clock) return;
+
+                for (Ticks* ticks : m_ticks)
+                {
+                    if (ticks) ticks->stamp(begin, end, *m_clock);
+                }
+            }
+                        
+            bool done() const { return m_block_begin + m_offset >= *m_end; }
+        
+            bool empty() const { return *m_end == 0; }
+
+            size_t size() const { return *m_end; }
+
+            auto operator*() -> Extraction<Cs...>
+            {
+                if constexpr (!(std::is_const_v<Cs> && ...))
+                {
+                    stamp(m_block_begin + m_offset, m_block_begin + m_offset + 1);
+                }
+
+                return {m_block_ids[m_offset], extract_all()};
+            }
+
+            size_t block_of(size_t index) const { return m_ids->block_of(index); }
+
+            size_t block_begin(size_t block) const { return m_ids->block_begin(block); }
+
+            // The number of blocks holding iterable entities, always 1 for non-empty contiguous pools.
+            size_t blocks() const 
+            {
+                return m_ids->block_count(*m_end);
+            }
+
+            // Ids of the iterable entities of a block, in pool order.
+            auto id_span(size_t block = 0) const -> std::span<const EntityId>
+            {
+                return m_ids->block(block, *m_end);
+            }
+
+            // Contiguous component columns of the iterable entities of a block, in pool order.
+            auto columns(size_t block = 0) const -> Data<std::span<Cs>...>
+            {
+                return {std::get<IteratorVector<Cs>>(m_data)->block(block, *m_end)...};
+            }
+
+            // Random access into the pool, used to iterate over index ranges.
+            auto operator[](size_t index) -> Extraction<Cs...>
+            {
+                return {(*m_ids)[index], std::tie((*std::get<IteratorVector<Cs>>(m_data))[index]...)};
+            }
+        
+            /**
+             * Moves on to the next block once the current one is exhausted.
+             * 
+             * @returns False if there are no entities left.
+             */
+            bool next_block()
+            {
+                if (done()) return false;
+
+                load(m_block_begin + m_offset);
+                return true;
+            }
+
+            // Checking for the end is where the iterator steps into the next block,
+            // so that incrementing inside of a block stays a single addition.
+            bool operator!=(std::default_sentinel_t) 
+            {
+                return m_offset != m_length || next_block();
+            }
+        
+            Iterator<Cs...>& operator++() 
+            {
+                ++m_offset;
+                return *this;
+            }
+        
+            Iterator<Cs...>& begin() 
+            {
+                m_block_begin = 0;
+                m_offset = 0;
+                m_length = 0;
+                return *this;
+            }
+        
+            auto end() const -> std::default_sentinel_t
+            {
+                return std::default_sentinel;
+            }
+    };
+
+    // ----------------------------------------------------------------------------
+    // Sorting
+    // ---------------------------------------------------------------------------- 
+
+    /**
+     * How Registry::sort orders a pool.
+     */
+    enum SortMode : uint8_t
+    {
+        FULL_SORT, // A stable sort, or a radix sort when sorting by an integral key.
+        INSERTION_SORT, // An insertion sort, close to linear when the pool is nearly sorted.
+    };
+
+    /**
+     * Computes the stable order of a set of integral keys with an LSD radix 
+     * sort, one byte per pass. Passes over bytes that every key shares are skipped.
+     * 
+     * @param keys The keys to sort.
+     * 
+     * @returns The indices of the keys in sorted order.
+     */
+    template <typename K>
+    auto radix_order(std::span<const K> keys) -> std::vector<size_t>
+    {
+        using U = std::make_unsigned_t<K>;
+
+        // Flipping the sign bit makes signed keys sort correctly as unsigned ones.
+        constexpr U flip = std::is_signed_v<K> ? U(U(1) << (sizeof(K) * 8 - 1)) : U(0);
+
+        std::vector<size_t> order(keys.size());
+        std::vector<size_t> buffer(keys.size());
+        std::iota(order.begin(), order.end(), 0);
+
+        for (size_t shift = 0; shift < sizeof(K) * 8; shift += 8)
+        {
+            std::array<size_t, 256> counts = {};
+
+            auto digit = [&keys, &shift](size_t i)
+            {
+                return (static_cast<U>(static_cast<U>(keys[i]) ^ flip) >> shift) & 0xFF;
+            };
+
+            for (size_t i = 0; i < keys.size(); i++) counts[digit(i)]++;
+
+            if (keys.empty() || counts[digit(0)] == keys.size()) continue;
+
+            size_t offset = 0;
+
+            for (size_t& count : counts)
+            {
+                size_t c = count;
+                count = offset;
+                offset += c;
+            }
+
+            for (size_t i : order) buffer[counts[digit(i)]++] = i;
+
+            order.swap(buffer);
+        }
+
+        return order;
+    }
+
+    /**
+     * Computes the stable order of count elements with an insertion sort.
+     * 
+     * @param count The number of elements.
+     * @param less Must be invocable<size_t, size_t>, compares two elements by index.
+     * 
+     * @returns The indices of the elements in sorted order.
+     */
+    template <typename Less>
+    auto insertion_order(size_t count, Less&& less) -> std::vector<size_t>
+    {
+        std::vector<size_t> order(count);
+        std::iota(order.begin(), order.end(), 0);
+
+        for (size_t i = 1; i < count; i++)
+        {
+            size_t current = order[i];
+            size_t j = i;
+
+            for (; j > 0 && less(current, order[j - 1]); j--)
+            {
+                order[j] = order[j - 1];
+            }
+
+            order[j] = current;
+        }
+
+        return order;
+    }
+
+    // ----------------------------------------------------------------------------
+    // Pool
+    // ---------------------------------------------------------------------------- 
+
+    // A word of pool occupancy bits, one bit per archetype.
+    using OccupancyWord = std::atomic<uint64_t>;
+
+    /**
+     * Occupancy bits of every pool of one state, indexed by archetype id.
+     * A bit is set while its pool has iterable entities.
+     * 
+     * @tparam N The number of archetypes.
+     */
+    template <size_t N>
+    using Occupancy = std::array<OccupancyWord, (N + 63) / 64>;
+
+    /**
+     * Base archetype storage class.
+     * Contains functions for adding, removing and retrieving component data,
+     * as well as an iterator and utility functions.
+     * 
+     * The pool is always called on internally and is not exposed.
+     * 
+     * @tparam A The archetype of the pool.
+     */
+    template <typename A>
+    class Pool
+    {
+        static_assert((BlockSize<A>::value & (BlockSize<A>::value - 1)) == 0, "@Pool: BlockSize must be 0 or a power of two.");
+
+        // A tuple of Column<C> for each component of the archetype.
+        using PoolData = WrapData<A, Data, Column>::type;
+
+        size_t m_end = 0;
+        size_t m_total = 0;
+        OccupancyWord* m_occupancy = nullptr;
+        uint64_t m_bit = 0;
+        bool m_occupied = false;
+        std::pmr::memory_resource* m_resource = std::pmr::get_default_resource();
+        PoolData m_data = make_data(m_resource);
+        Column<EntityId> m_ids = Column<EntityId>(m_resource, BlockSize<A>::value);
+
+        // Change ticks of every component, followed by the ticks at which entities were added.
+        std::array<Ticks, std::tuple_size_v<A> + 1> m_ticks = make_ticks(m_resource);
+        const Tick* m_clock = nullptr;
+
+        static auto make_ticks(std::pmr::memory_resource* resource) -> std::array<Ticks, std::tuple_size_v<A> + 1>
+        {
+            return [resource]<size_t... Is>(std::index_sequence<Is...>)
+            {
+                return std::array<Ticks, sizeof...(Is)>{((void)Is, Ticks(resource, BlockSize<A>::value))...};
+            }
+            (std::make_index_sequence<std::tuple_size_v<A> + 1>{});
+        }
+
+        Tick now() const
+        {
+            return m_clock ? *m_clock : 0;
+        }
+
+        static auto make_data(std::pmr::memory_resource* resource) -> PoolData
+        {
+            return [resource]<typename... Cs>(Data<Cs...>)
+            {
+                return PoolData{Column<Cs>(resource, BlockSize<A>::value)...};
+            }
+            (A{});
+        }
+
+        // Constructs a component at the end of its column or assigns it to the first dead slot.
+        template <typename C, typename T>
+        void construct(T&& component)
+        {
+            if (m_end == m_total)
+            {
+                vector<C>().emplace_back(std::forward<T>(component));
+            }
+            else if constexpr (std::is_same_v<std::remove_cvref_t<T>, C>)
+            {
+                vector<C>()[m_end] = std::forward<T>(component);
+            }
+            else 
+            {
+                vector<C>()[m_end] = C(std::forward<T>(component));
+            }
+        }
+
+        template <typename C>
+        void erase()
+        {
+            vector<C>().truncate(m_end);
+            m_total = m_end;
+        }
+
+        // Relocates the last iterable component into the slot at index. 
+        template <typename C>
+        void move_back(size_t index)
+        {
+            auto& v = vector<C>();
+
+            if constexpr (std::is_trivially_copyable_v<C>)
+            {
+                std::memcpy(static_cast<void*>(&v[index]), &v[m_end - 1], sizeof(C));
+            }
+            else 
+            {
+                v[index] = std::move(v[m_end - 1]);
+            }
+        }
+
+        // Moves a component between two slots of its column.
+        template <typename C>
+        void move_to(size_t from, size_t to)
+        {
+            auto& v = vector<C>();
+            v[to] = std::move(v[from]);
+        }
+
+        // Keeps the pool's occupancy bit in sync, only touching it when the pool empties or fills up.
+        void occupy()
+        {
+            if (!m_occupancy || (m_end != 0) == m_occupied) return;
+
+            m_occupied = m_end != 0;
+
+            if (m_occupied) m_occupancy->fetch_or(m_bit, std::memory_order_relaxed);
+            else m_occupancy->fetch_and(~m_bit, std::memory_order_relaxed);
+        }
+
+        public: 
+            size_t total()
+            {
+                return m_total;
+            }
+
+            size_t count()
+            {
+                return m_end;
+            }
+
+            /**
+             * Binds the pool to its bit in an occupancy mask.
+             * 
+             * @param word The mask word holding the pool's bit.
+             * @param bit The pool's bit in that word.
+             */
+            void track(OccupancyWord* word, uint64_t bit)
+            {
+                m_occupancy = word;
+                m_bit = bit;
+                m_occupied = false;
+                occupy();
+            }
+
+            // Binds the pool to the tick counter that changes are stamped with.
+            void clock(const Tick* tick)
+            {
+                m_clock = tick;
+            }
+
+            /**
+             * Gets the change ticks of a component, or the ticks at which 
+             * entities were added to the pool if T is Added.
+             */
+            template <typename T>
+            auto ticks() -> Ticks&
+            {
+                if constexpr (std::is_same_v<T, Added>) return m_ticks.back();
+                else return m_ticks[Filter::index_of<std::remove_const_t<T>, A>::value];
+            }
+
+            // Stamps a component of an entity as changed, does nothing for const components.
+            template <typename C>
+            void mark(size_t index)
+            {
+                if constexpr (!std::is_const_v<C>) ticks<C>().set(index, now());
+            }
+
+            /**
+             * Adds an entity, moving its components in if it is an rvalue.
+             * 
+             * @param id The entity's id.
+             * @param entity The archetype tuple to add.
+             */
+            template <typename Entity>
+            void add(EntityId id, Entity&& entity)
+            {
+                [this, &id, &entity]<typename... Cs>(Data<Cs...>)
+                {
+                    emplace(id, std::get<Cs>(std::forward<Entity>(entity))...);
+                }
+                (A{});
+            }
+
+            /**
+             * Adds an entity by constructing each component in place.
+             * 
+             * @param id The entity's id.
+             * @param args One constructor argument per component, in archetype order.
+             */
+            template <typename... Args>
+            void emplace(EntityId id, Args&&... args)
+            {
+                [this, &id, &args...]<typename... Cs>(Data<Cs...>)
+                {
+                    static_assert(sizeof...(Cs) == sizeof...(Args), "@Pool::emplace: Expected one argument per component.");
+
+                    (construct<Cs>(std::forward<Args>(args)),...);
+
+                    if (m_end == m_total)
+                    {
+                        m_ids.emplace_back(id);
+                        for (Ticks& t : m_ticks) t.append(1, now());
+                        m_total++;
+                    }
+                    else 
+                    {
+                        m_ids[m_end] = id;
+                        for (Ticks& t : m_ticks) t.set(m_end, now());
+                    }
+
+                    m_end++;
+                    occupy();
+                }
+                (A{});
+            }
+
+            /**
+             * Moves an entity's components into another pool without copying them.
+             * The slot at index is left moved-from and should be removed afterwards.
+             * 
+             * @param index The entity's index in this pool.
+             * @param target The pool to add the entity to.
+             */
+            void relocate(size_t index, Pool<A>& target)
+            {
+                [this, &index, &target]<typename... Cs>(Data<Cs...>)
+                {
+                    target.emplace(m_ids[index], std::move(vector<Cs>()[index])...);
+                }
+                (A{});
+            }
+
+            /**
+             * Adds a block of copies of one entity, one per id.
+             * Dead slots are overwritten first, the rest is constructed in bulk 
+             * at the end of each column.
+             */
+            template <typename... Cs>
+            void fill(std::span<const EntityId> ids, const Data<Cs...>& entity)
+            {
+                size_t count = ids.size();
+                size_t reused = std::min(count, m_total - m_end);
+
+                for (size_t i = m_end; i < m_end + reused; i++)
+                {
+                    ((vector<Cs>()[i] = std::get<Cs>(entity)),...);
+                }
+
+                ((vector<Cs>().append(count - reused, std::get<Cs>(entity))),...);
+                m_ids.append(count - reused, 0);
+
+                for (size_t i = 0; i < count; i++)
+                {
+                    m_ids[m_end + i] = ids[i];
+                }
+
+                for (Ticks& t : m_ticks)
+                {
+                    for (size_t i = m_end; i < m_end + reused; i++) t.set(i, now());
+                    t.append(count - reused, now());
+                }
+
+                m_end += count;
+                m_total = std::max(m_total, m_end);
+                occupy();
+            }
+
+            // Reserves capacity for a number of entities in every column.
+            void reserve(size_t count)
+            {
+                NECS_TRACE_SCOPE("Pool::reserve");
+
+                [this, &count]<typename... Cs>(Data<Cs...>)
+                {
+                    (vector<Cs>().reserve(count),...);
+                    m_ids.reserve(count);
+                }
+                (A{});
+            }
+
+            // Makes room for count more entities, growing geometrically like push_back would.
+            void grow(size_t count)
+            {
+                size_t needed = m_end + count;
+
+                if (needed > m_ids.capacity())
+                {
+                    NECS_TRACE_SCOPE("Pool::grow");
+                    reserve(std::max(needed, m_ids.capacity() * 2));
+                }
+            }
+
+            size_t capacity()
+            {
+                return m_ids.capacity();
+            }
+
+            auto resource() -> std::pmr::memory_resource*
+            {
+                return m_resource;
+            }
+
+            /**
+             * Moves every column, the ids and the change ticks into memory from another resource. 
+             * Capacity is kept, dead slots are dropped.
+             * 
+             * @param resource The resource to allocate from, must outlive the pool.
+             */
+            void set_resource(std::pmr::memory_resource* resource)
+            {
+                NECS_TRACE_SCOPE("Pool::set_resource");
+
+                trim();
+
+                [this, &resource]<typename... Cs>(Data<Cs...>)
+                {
+                    PoolData data = make_data(resource);
+                    Column<EntityId> ids(resource, BlockSize<A>::value);
+
+                    ((std::get<Column<Cs>>(data).reserve(vector<Cs>().capacity())),...);
+                    ids.reserve(m_ids.capacity());
+
+                    for (size_t i = 0; i < m_total; i++)
+                    {
+                        ((std::get<Column<Cs>>(data).emplace_back(std::move(vector<Cs>()[i]))),...);
+                        ids.emplace_back(m_ids[i]);
+                    }
+
+                    // Move assignment would copy into the old resource, since
+                    // polymorphic allocators do not propagate. Rebuild instead.
+                    std::destroy_at(&m_data);
+                    std::construct_at(&m_data, std::move(data));
+                    std::destroy_at(&m_ids);
+                    std::construct_at(&m_ids, std::move(ids));
+                }
+                (A{});
+
+                for (Ticks& t : m_ticks) t.set_resource(resource);
+
+                m_resource = resource;
+            }
+
+            void trim()
+            {
+                [this]<typename... Cs>(Data<Cs...>)
+                {
+                    if (m_end < m_total)
+                    {
+                        m_ids.truncate(m_end);
+                        for (Ticks& t : m_ticks) t.truncate(m_end);
+                        ((erase<Cs>()),...);
+                    }
+                }
+                (A{});
+            }
+
+            /**
+             * Undoes the additions made since the pool held end iterable 
+             * entities and total constructed slots, after one of them threw. 
+             * Slots constructed since are destroyed, so that every column has 
+             * total elements again, and overwritten dead slots stay dead.
+             */
+            void rollback(size_t end, size_t total)
+            {
+                [this, &total]<typename... Cs>(Data<Cs...>)
+                {
+                    (vector<Cs>().truncate(total),...);
+                }
+                (A{});
+
+                m_ids.truncate(total);
+                for (Ticks& t : m_ticks) t.truncate(total);
+
+                m_total = total;
+                m_end = end;
+                occupy();
+            }
+
+            /**
+             * Drops the dead slots and releases the unused capacity of every 
+             * column, the ids and the change ticks.
+             */
+            void shrink()
+            {
+                NECS_TRACE_SCOPE("Pool::shrink");
+
+                trim();
+
+                [this]<typename... Cs>(Data<Cs...>)
+                {
+                    (vector<Cs>().shrink_to_fit(),...);
+                }
+                (A{});
+
+                m_ids.shrink_to_fit();
+                for (Ticks& t : m_ticks) t.shrink_to_fit();
+            }
+
+            // The bytes taken up by one entity across the columns, its id and its change ticks.
+            static constexpr size_t ENTITY_BYTES = []<typename... Cs>(std::type_identity<Data<Cs...>>)
+            {
+                return (sizeof(Cs) + ... + 0) + sizeof(EntityId) + (sizeof...(Cs) + 1) * sizeof(Tick);
+            }
+            (std::type_identity<A>{});
+
+            // The bytes reserved by the pool's columns, ids and change ticks.
+            size_t memory()
+            {
+                size_t bytes = [this]<typename... Cs>(Data<Cs...>)
+                {
+                    return ((vector<Cs>().capacity() * sizeof(Cs)) + ... + 0);
+                }
+                (A{});
+
+                bytes += m_ids.capacity() * sizeof(EntityId);
+                for (const Ticks& t : m_ticks) bytes += t.memory();
+
+                return bytes;
+            }
+
+            // The bytes reserved by the pool that no iterable entity uses.
+            size_t unused_memory()
+            {
+                return memory() - std::min(memory(), count() * ENTITY_BYTES);
+            }
+
+            /**
+             * Fills a report of the pool's memory, reusing the report's column list.
+             * Walks the columns of HeapSized components, reads capacities otherwise.
+             */
+            void report(PoolReport& report)
+            {
+                report.count = m_end;
+                report.dead = m_total - m_end;
+                report.capacity = capacity();
+                report.bytes = memory();
+                report.heap_bytes = 0;
+                report.columns.resize(std::tuple_size_v<A>);
+
+                [this, &report]<typename... Cs>(Data<Cs...>)
+                {
+                    size_t i = 0;
+
+                    auto f = [this, &report, &i]<typename C>(Column<C>& column)
+                    {
+                        ColumnReport& c = report.columns[i++];
+                        c.name = typeid(C).name();
+                        c.size = column.size();
+                        c.capacity = column.capacity();
+                        c.bytes = column.capacity() * sizeof(C);
+                        c.heap_bytes = 0;
+
+                        if constexpr (HeapSized<C>)
+                        {
+                            for (size_t j = 0; j < m_total; j++) c.heap_bytes += column[j].heap_size();
+                        }
+
+                        report.heap_bytes += c.heap_bytes;
+                    };
+
+                    (f(vector<Cs>()),...);
+                }
+                (A{});
+            }
+
+            /**
+             * Writes the iterable entities to a snapshot: their count, their ids 
+             * and then every column. Dead slots are left out.
+             */
+            void save(std::ostream& out)
+            {
+                write_value<uint64_t>(out, m_end);
+                m_ids.save(out, m_end);
+
+                [this, &out]<typename... Cs>(Data<Cs...>)
+                {
+                    (vector<Cs>().save(out, m_end),...);
+                }
+                (A{});
+            }
+
+            /**
+             * Replaces the entities of the pool with the ones of a snapshot. 
+             * The exact capacity is reserved once and every column is read in 
+             * bulk. Loaded entities are stamped as added and changed now.
+             */
+            void load(std::istream& in)
+            {
+                NECS_TRACE_SCOPE("Pool::load");
+
+                // Every entity takes at least its id and its trivially copyable components.
+                size_t entity_bytes = [this]<typename... Cs>(Data<Cs...>)
+                {
+                    return sizeof(EntityId) + ((std::is_trivially_copyable_v<Cs> ? sizeof(Cs) : 0) + ... + size_t(0));
+                }
+                (A{});
+
+                size_t count = read_length(in, entity_bytes, std::numeric_limits<PoolIndex>::max());
+
+                m_end = 0;
+                m_total = 0;
+                m_ids.truncate(0);
+                for (Ticks& t : m_ticks) t.truncate(0);
+
+                [this, &in, &count]<typename... Cs>(Data<Cs...>)
+                {
+                    (vector<Cs>().truncate(0),...);
+
+                    m_ids.load(in, count);
+                    (vector<Cs>().load(in, count),...);
+                }
+                (A{});
+
+                for (Ticks& t : m_ticks) t.append(count, now());
+
+                m_end = count;
+                m_total = count;
+                occupy();
+            }
+
+            auto ids() -> const Column<EntityId>&
+            {
+                return m_ids;
+            }
+
+            template <typename C>
+            auto vector() -> Column<C>&
+            {
+                return std::get<Column<C>>(m_data);
+            }
+
+            auto get(size_t index)
+            {
+                return [this, &index]<typename... Cs>(Data<Cs...>)
+                {
+                    return get<Cs...>(index);
+                }
+                (A{});
+            }
+        
+            template <typename... Cs>
+            auto get(size_t index) -> Data<Cs&...>
+            {
+                return Data<Cs&...>(vector<std::remove_const_t<Cs>>()[index]...);
+            }
+
+            auto clone(size_t index)
+            {
+                return [this, &index]<typename... Cs>(Data<Cs...>)
+                {
+                    return clone<Cs...>(index);
+                }
+                (A{});
+            }    
+
+            template <typename... Cs>
+            auto clone(size_t index) -> Data<Cs...>
+            {
+                return get<Cs...>(index);
+            }    
+        
+            /**
+             * Removes the entity at index by moving the last iterable entity into
+             * its slot. The freed slot at the end becomes dead memory.
+             * 
+             * @returns The id of the entity that now occupies index.
+             */
+            auto remove(size_t index) -> EntityId 
+            {
+                [this, &index]<typename... Cs>(Data<Cs...>)
+                {
+                    if (index != m_end - 1)
+                    {
+                        (move_back<Cs>(index),...);
+                        m_ids[index] = m_ids[m_end - 1];
+                        for (Ticks& t : m_ticks) t.move(m_end - 1, index);
+                    }
+
+                    m_end--;
+                    occupy();
+                }
+                (A{});
+
+                return m_ids[index];
+            }
+
+            /**
+             * Removes a set of entities at once. 
+             * 
+             * By default every entity is swapped with the last iterable entity, 
+             * starting from the highest index so that only entities that are not 
+             * being removed get moved. With preserve_order the pool is compacted 
+             * in a single pass instead, which keeps the order of the rest intact.
+             * 
+             * @tparam Moved Must be invocable<EntityId, size_t>.
+             * 
+             * @param indices The indices to remove, sorted in ascending order.
+             * @param preserve_order Whether to compact instead of swapping.
+             * @param moved Called with every remaining entity that changes index.
+             */
+            template <typename Moved>
+            void remove_many(std::span<const size_t> indices, bool preserve_order, Moved&& moved)
+            {
+                if (indices.empty()) return;
+
+                if (!preserve_order)
+                {
+                    for (auto it = indices.rbegin(); it != indices.rend(); ++it)
+                    {
+                        bool is_last = *it == m_end - 1;
+                        EntityId swapped = remove(*it);
+
+                        if (!is_last) moved(swapped, *it);
+                    }
+
+                    return;
+                }
+
+                [this, &indices, &moved]<typename... Cs>(Data<Cs...>)
+                {
+                    size_t write = indices.front();
+                    size_t next = 0;
+
+                    for (size_t read = indices.front(); read < m_end; read++)
+                    {
+                        if (next < indices.size() && indices[next] == read)
+                        {
+                            next++;
+                            continue;
+                        }
+
+                        (move_to<Cs>(read, write),...);
+                        m_ids[write] = m_ids[read];
+                        for (Ticks& t : m_ticks) t.move(read, write);
+                        moved(m_ids[write], write);
+                        write++;
+                    }
+
+                    m_end = write;
+                    occupy();
+                }
+                (A{});
+            }
+
+            /**
+             * Reorders the iterable entities, the entity at order[i] moves to 
+             * index i. Every column, the ids and the change ticks are permuted 
+             * the same way.
+             * 
+             * @tparam Moved Must be invocable<EntityId, size_t>.
+             * 
+             * @param order A permutation of the iterable indices.
+             * @param moved Called with every entity that changes index.
+             */
+            template <typename Moved>
+            void permute(std::span<const size_t> order, Moved&& moved)
+            {
+                if (std::is_sorted(order.begin(), order.end())) return;
+
+                [this, &order]<typename... Cs>(Data<Cs...>)
+                {
+                    auto gather = [&order]<typename T>(Column<T>& column)
+                    {
+                        std::vector<T> buffer;
+                        buffer.reserve(order.size());
+
+                        for (size_t i : order) buffer.push_back(std::move(column[i]));
+                        for (size_t i = 0; i < order.size(); i++) column[i] = std::move(buffer[i]);
+                    };
+
+                    (gather(vector<Cs>()),...);
+                    gather(m_ids);
+                }
+                (A{});
+
+                for (Ticks& t : m_ticks) t.permute(order);
+
+                for (size_t i = 0; i < order.size(); i++)
+                {
+                    if (order[i] != i) moved(m_ids[i], i);
+                }
+            }
+
+            /**
+             * Sorts the iterable entities by a component. 
+             * 
+             * @tparam C The component to sort by.
+             * @tparam By Either a key, invocable<const C&>, or a comparison, 
+             * invocable<const C&, const C&> returning whether the first goes first.
+             * @tparam Moved Must be invocable<EntityId, size_t>.
+             * 
+             * @param by The key or comparison.
+             * @param mode FULL_SORT uses a radix sort for integral keys and a 
+             * stable sort otherwise, INSERTION_SORT is meant for nearly sorted pools.
+             * @param moved Called with every entity that changes index.
+             */
+            template <typename C, typename By, typename Moved>
+            void sort_by(By&& by, SortMode mode, Moved&& moved)
+            {
+                NECS_TRACE_SCOPE("Pool::sort_by");
+
+                Column<C>& column = vector<C>();
+                std::vector<size_t> order;
+
+                if constexpr (std::is_invocable_v<By, const C&>)
+                {
+                    using Key = std::remove_cvref_t<std::invoke_result_t<By, const C&>>;
+
+                    std::vector<Key> keys;
+                    keys.reserve(m_end);
+
+                    for (size_t i = 0; i < m_end; i++) keys.push_back(by(std::as_const(column[i])));
+
+                    auto less = [&keys](size_t a, size_t b) { return keys[a] < keys[b]; };
+
+                    if (mode == INSERTION_SORT)
+                    {
+                        order = insertion_order(m_end, less);
+                    }
+                    else if constexpr (std::is_integral_v<Key> && !std::is_same_v<Key, bool>)
+                    {
+                        order = radix_order(std::span<const Key>(keys));
+                    }
+                    else 
+                    {
+                        order.resize(m_end);
+                        std::iota(order.begin(), order.end(), 0);
+                        std::stable_sort(order.begin(), order.end(), less);
+                    }
+                }
+                else 
+                {
+                    static_assert
+                    (
+                        std::is_invocable_r_v<bool, By, const C&, const C&>, 
+                        "@Pool::sort_by: Expected a key or a comparison of two components."
+                    );
+
+                    auto less = [&column, &by](size_t a, size_t b) 
+                    { 
+                        return by(std::as_const(column[a]), std::as_const(column[b])); 
+                    };
+
+                    if (mode == INSERTION_SORT)
+                    {
+                        order = insertion_order(m_end, less);
+                    }
+                    else 
+                    {
+                        order.resize(m_end);
+                        std::iota(order.begin(), order.end(), 0);
+                        std::stable_sort(order.begin(), order.end(), less);
+                    }
+                }
+
+                permute(order, std::forward<Moved>(moved));
+            }
+
+            template <typename... Cs>
+            auto iter() -> Iterator<Cs...>
+            {
+                auto ids_ptr = &m_ids;
+                auto end_ptr = &m_end;
+            
+                auto data = std::make_tuple(&vector<std::remove_const_t<Cs>>()...);
+
+                std::array<Ticks*, sizeof...(Cs)> changes = {(std::is_const_v<Cs> ? nullptr : &ticks<Cs>())...};
+            
+                return Iterator<Cs...>(ids_ptr, data, end_ptr, changes, m_clock);
+            }
+    };
+
+    // ----------------------------------------------------------------------------
+    // Storage
+    // ---------------------------------------------------------------------------- 
+
+    /**
+     * Top-level archetype container. 
+     * 
+     * Each storage contains a living and sleeping pool, as well as functions for 
+     * interacting with them. It also has some functions for applying updates to 
+     * an entity's state.
+     * 
+     * @tparam A The archetype of this storage.
+     */
+    template <typename A>
+    struct Storage
+    {
+        Pool<A> living;
+        Pool<A> sleeping;
+
+        // Gets components for access from outside, stamping the non-const ones as changed.
+        template <typename... Cs>
+        auto get(size_t index, bool sleeping_pool) -> Data<Cs&...>
+        {   
+            auto& data = sleeping_pool ? sleeping : living;
+            (data.template mark<Cs>(index),...);
+            return data.template get<Cs...>(index);
+        }
+
+        template <typename... Cs>
+        auto iter(bool sleeping_pool) -> Iterator<Cs...>
+        {
+            auto& data = sleeping_pool ? sleeping : living;
+            return data.template iter<Cs...>();
+        }
+
+        auto pool(bool sleeping_pool) -> Pool<A>&
+        {
+            return sleeping_pool ? sleeping : living;
+        }
+    };
+    
+    template <typename As>
+    using Storages = WrapData<As, Data, Storage>::type;
+
+    // ----------------------------------------------------------------------------
+    // Thread pool
+    // ----------------------------------------------------------------------------
+
+    // The number of slices a parallel iteration aims to create per worker.
+    const size_t SLICES_PER_WORKER = 4;
+
+    /**
+     * Where a command was recorded. Registry::flush applies commands in key 
+     * order, which does not depend on the thread that recorded them.
+     * 
+     * Every thread has a current key. Outside of parallel batches each command 
+     * takes the next step. Tasks of ThreadPool::run share the step of their 
+     * batch and are told apart by their task index, and the commands of a task 
+     * by their sequence. Query::par_for_each uses the entity instead of the task 
+     * index, so that keys do not depend on how entities were sliced, and the 
+     * scheduler gives every system its own scope, within an epoch taken from 
+     * the registry for every run so that repeated runs never share keys. 
+     * Batches started from inside a task are not ordered.
+     */
+    struct CommandKey
+    {
+        uint64_t epoch = 0; // The scheduler run, see Registry::next_epoch, 0 outside the scheduler.
+        uint64_t scope = 0; // The system plus one, 0 outside the scheduler.
+        uint64_t step = 0; // The command or parallel batch within the scope.
+        uint64_t item = 0; // The task or entity of the batch plus one, 0 outside batches.
+        uint64_t sequence = 0; // The command within the item.
+
+        auto operator<=>(const CommandKey&) const = default;
+
+        // The key of the calling thread.
+        static auto current() -> CommandKey&
+        {
+            static thread_local CommandKey t_key;
+            return t_key;
+        }
+
+        // Takes the key of the next command recorded on the calling thread.
+        static auto next() -> CommandKey
+        {
+            CommandKey& key = current();
+            CommandKey taken = key;
+
+            if (key.item == 0) key.step++;
+            else key.sequence++;
+
+            return taken;
+        }
+    };
+
+    /**
+     * Sets the command key of the calling thread and restores the previous one 
+     * when destroyed. Lets custom parallel code order the commands it records.
+     */
+    class CommandScope
+    {
+        CommandKey m_saved;
+
+        public:
+            explicit CommandScope(CommandKey key) : m_saved(CommandKey::current())
+            {
+                CommandKey::current() = key;
+            }
+
+            CommandScope(const CommandScope&) = delete;
+            CommandScope& operator=(const CommandScope&) = delete;
+
+            ~CommandScope()
+            {
+                CommandKey::current() = m_saved;
+            }
+    };
+
+    /**
+     * Work-stealing thread pool.
+     *
+     * Each worker owns a task deque. Workers pop tasks from the back of their own
+     * deque and steal from the front of the others when they run out of work.
+     * Threads waiting on a batch keep running queued tasks instead of blocking,
+     * which makes it safe to start a batch from inside another batch.
+     */
+    class ThreadPool
+    {
+        using Task = std::function<void()>;
+
+        struct Worker
+        {
+            std::mutex mutex;
+            std::deque<Task> tasks;
+        };
+
+        static inline thread_local ThreadPool* t_pool = nullptr;
+        static inline thread_local size_t t_index = 0;
+
+        std::vector<std::unique_ptr<Worker>> m_workers;
+        std::vector<std::thread> m_threads;
+        std::mutex m_mutex;
+        std::condition_variable m_signal;
+        std::atomic<size_t> m_queued = 0;
+        std::atomic<size_t> m_next = 0;
+        bool m_stop = false;
+
+        void push(Task task)
+        {
+            size_t index = t_pool == this
+                ? t_index
+                : m_next.fetch_add(1, std::memory_order_relaxed) % m_workers.size();
+
+            {
+                std::lock_guard lock(m_workers[index]->mutex);
+                m_workers[index]->tasks.push_back(std::move(task));
+            }
+
+            m_queued++;
+
+            {
+                std::lock_guard lock(m_mutex);
+            }
+
+            m_signal.notify_one();
+        }
+
+        /**
+         * Runs a single queued task. Workers take from the back of their own
+         * deque first, everything else is stolen from the front.
+         *
+         * @returns False if there was nothing to run.
+         */
+        bool run_one()
+        {
+            bool is_worker = t_pool == this;
+            size_t start = is_worker ? t_index : 0;
+            size_t count = m_workers.size();
+            Task task;
+
+            for (size_t n = 0; n < count && !task; n++)
+            {
+                Worker& worker = *m_workers[(start + n) % count];
+                std::lock_guard lock(worker.mutex);
+
+                if (worker.tasks.empty()) continue;
+
+                if (is_worker && n == 0)
+                {
+                    task = std::move(worker.tasks.back());
+                    worker.tasks.pop_back();
+                }
+                else
+                {
+                    task = std::move(worker.tasks.front());
+                    worker.tasks.pop_front();
+                }
+
+                m_queued--;
+            }
+
+            if (!task) return false;
+
+            task();
+            return true;
+        }
+
+        void work(size_t index)
+        {
+            t_pool = this;
+            t_index = index;
+
+            while (true)
+            {
+                if (run_one()) continue;
+
+                std::unique_lock lock(m_mutex);
+                m_signal.wait(lock, [this]() { return m_stop || m_queued > 0; });
+
+                if (m_stop && m_queued == 0) return;
+            }
+        }
+
+        public:
+            /**
+             * @param count The number of worker threads. With 0 workers every
+             * batch runs on the calling thread.
+             */
+            explicit ThreadPool(size_t count = std::thread::hardware_concurrency())
+            {
+                for (size_t i = 0; i < count; i++)
+                {
+                    m_workers.push_back(std::make_unique<Worker>());
+                }
+
+                for (size_t i = 0; i < count; i++)
+                {
+                    m_threads.emplace_back([this, i]() { work(i); });
+                }
+            }
+
+            ThreadPool(const ThreadPool&) = delete;
+            ThreadPool& operator=(const ThreadPool&) = delete;
+
+            ~ThreadPool()
+            {
+                {
+                    std::lock_guard lock(m_mutex);
+                    m_stop = true;
+                }
+
+                m_signal.notify_all();
+
+                for (auto& thread : m_threads) thread.join();
+            }
+
+            // The number of worker threads.
+            size_t size() const
+            {
+                return m_threads.size();
+            }
+
+            // The index of the calling worker thread, or -1 if the caller is not one of this pool's workers.
+            size_t worker_index() const
+            {
+                return t_pool == this ? t_index : static_cast<size_t>(-1);
+            }
+
+            /**
+             * Runs a batch of tasks and blocks until all of them are done.
+             * The calling thread helps with the batch while it waits. Each task
+             * records commands under its own CommandKey. If tasks throw, the rest
+             * of the batch still runs and the first exception is rethrown on the
+             * calling thread once the whole batch is done.
+             *
+             * @tparam F Must be invocable<size_t> and safe to call concurrently.
+             *
+             * @param count The number of tasks in the batch.
+             * @param f The task, called once with every index in [0, count).
+             */
+            template <typename F>
+            void run(size_t count, F&& f)
+            {
+                CommandKey batch = CommandKey::next();
+
+                auto task = [&f, &batch](size_t i)
+                {
+                    CommandScope scope({batch.epoch, batch.scope, batch.step, i + 1, 0});
+                    f(i);
+                };
+
+                if (m_threads.empty() || count == 1)
+                {
+                    for (size_t i = 0; i < count; i++) task(i);
+                    return;
+                }
+
+                std::atomic<size_t> remaining = count;
+                std::exception_ptr error;
+                std::mutex error_mutex;
+
+                for (size_t i = 0; i < count; i++)
+                {
+                    push([&task, &remaining, &error, &error_mutex, i]()
+                    {
+                        // Tasks must never throw out of a worker, and the batch must finish before run unwinds.
+                        try
+                        {
+                            task(i);
+                        }
+                        catch (...)
+                        {
+                            std::lock_guard lock(error_mutex);
+                            if (!error) error = std::current_exception();
+                        }
+
+                        remaining.fetch_sub(1, std::memory_order_release);
+                    });
+                }
+
+                while (remaining.load(std::memory_order_acquire) > 0)
+                {
+                    if (!run_one()) std::this_thread::yield();
+                }
+
+                if (error) std::rethrow_exception(error);
+            }
+    };
+
+    // ----------------------------------------------------------------------------
+    // Query
+    // ---------------------------------------------------------------------------- 
+
+    /**
+     * An iterator over one matching pool, tagged with its archetype id.
+     * 
+     * @tparam Cs... The components to iterate through.
+     */
+    template <typename... Cs>
+    struct QueryEntry
+    {
+        ArchetypeId archetype;
+        Iterator<Cs...> iter;
+        Ticks* ticks = nullptr; // The ticks filtered on, if any.
+    };
+
+    /**
+     * The matching pools of a query, built once by the registry and reused by 
+     * every query with the same components and filters.
+     * 
+     * @tparam Cs... The components to iterate through.
+     */
+    template <typename... Cs>
+    struct QueryTable
+    {
+        std::vector<QueryEntry<Cs...>> living;
+        std::vector<QueryEntry<Cs...>> sleeping;
+
+        /**
+         * @tparam Archetypes All of the registry's archetypes, used for archetype ids.
+         * @tparam Tracked The component whose change ticks to filter on, Added for 
+         * the ticks at which entities were added, void for none.
+         * 
+         * @param storages The matching storages.
+         */
+        template <typename Archetypes, typename Tracked, typename... As>
+        QueryTable(std::type_identity<Archetypes>, std::type_identity<Tracked>, Data<Storage<As>&...> storages)
+        {
+            auto f = [this]<typename A>(Storage<A>& storage)
+            {
+                ArchetypeId archetype = Filter::index_of<A, Archetypes>::value;
+                Ticks* living_ticks = nullptr;
+                Ticks* sleeping_ticks = nullptr;
+
+                if constexpr (!std::is_void_v<Tracked>)
+                {
+                    living_ticks = &storage.living.template ticks<Tracked>();
+                    sleeping_ticks = &storage.sleeping.template ticks<Tracked>();
+                }
+
+                living.push_back({archetype, storage.template iter<Cs...>(false), living_ticks});
+                sleeping.push_back({archetype, storage.template iter<Cs...>(true), sleeping_ticks});
+            };
+
+            ((f(std::get<Storage<As>&>(storages))),...);
+
+            if (living.size() == 0)
+            {
+                throw std::runtime_error("@Query::Query - no archetypes match. This query is redundant.");
+            }
+        }
+    };
+
+    /**
+     * Main iterator class, a view over the iterators of all the matching 
+     * storages in the system.
+     * 
+     * Queries do not own any memory: the pool iterators live in a table cached 
+     * by the registry, so constructing or copying a query is free. Empty pools 
+     * are skipped using the occupancy mask maintained by the pools, without 
+     * touching their memory.
+     */
+    template <typename... Cs>
+    class Query
+    {
+        const QueryEntry<Cs...>* m_data = nullptr;
+        size_t m_size = 0;
+        const OccupancyWord* m_occupancy = nullptr;
+        Iterator<Cs...> m_iterator;
+        size_t m_current = 0;
+
+        // Moves to the first occupied pool from the current one on.
+        void seek()
+        {
+            while (m_current < m_size && !is_occupied(m_current))
+            {
+                m_current++;
+            }
+
+            if (m_current < m_size) 
+            {
+                m_iterator = m_data[m_current].iter;
+                m_iterator.begin();
+            }
+        }
+
+        public: 
+            Query(std::span<const QueryEntry<Cs...>> entries, const OccupancyWord* occupancy) 
+                : m_data(entries.data()), m_size(entries.size()), m_occupancy(occupancy) {}
+
+            // The number of matching pools, including empty ones.
+            size_t size()
+            {
+                return m_size;
+            }
+
+            // Checks the occupancy mask to see if a matching pool has iterable entities.
+            bool is_occupied(size_t index) const
+            {
+                ArchetypeId archetype = m_data[index].archetype;
+                uint64_t word = m_occupancy[archetype / 64].load(std::memory_order_relaxed);
+                return word & (uint64_t(1) << (archetype % 64));
+            }
+
+            auto chunk(size_t index) -> Iterator<Cs...>
+            {
+                return m_data[index].iter;
+            }
+
+            // The ticks a matching pool is filtered on, null for unfiltered queries.
+            auto ticks(size_t index) const -> const Ticks*
+            {
+                return m_data[index].ticks;
+            }
+
+           /** 
+            * Alternative to for loops.
+            * Iterates through all the storages in the system that match the components.
+            * 
+            * @tparam Cs... The components to filter for. 
+            * @tparam Callback Must be invocable<EntityId, Data<Cs&...>.
+            * 
+            * @param callback The callback to execute for each entity.
+            */
+            template <typename Callback>
+            void for_each(Callback&& callback)
+            {
+                NECS_TRACE_SCOPE("Query::for_each");
+
+                static_assert(std::is_invocable_v<Callback, Extraction<Cs...>>, "For each callback must take Extraction<Cs...> as argument.");
+
+                for (size_t i = 0; i < size(); i++)
+                {
+                    if (!is_occupied(i)) continue;
+
+                    for (auto e : chunk(i))
+                    {
+                        callback(e);
+                    }
+                }
+            }
+
+            /**
+             * Chunk-level alternative to for_each.
+             * Calls the callback once per non-empty matching pool with contiguous
+             * spans over its ids and components, so that systems can be written
+             * as plain loops over arrays that the compiler can vectorize.
+             * 
+             * The mutable components of every span are stamped as changed 
+             * before it is handed out, a whole block at a time.
+             *
+             * @tparam Callback Must be invocable<std::span<const EntityId>, std::span<Cs>...>.
+             *
+             * @param callback The callback to execute for each pool.
+             */
+            template <typename Callback>
+            void each_chunk(Callback&& callback)
+            {
+                NECS_TRACE_SCOPE("Query::each_chunk");
+
+                static_assert(std::is_invocable_v<Callback, std::span<const EntityId>, std::span<Cs>...>, "Each chunk callback must take std::span<const EntityId>, std::span<Cs>... as arguments.");
+
+                for (size_t i = 0; i < size(); i++)
+                {
+                    if (!is_occupied(i)) continue;
+
+                    Iterator<Cs...> iter = chunk(i);
+
+                    for (size_t block = 0; block < iter.blocks(); block++)
+                    {
+                        iter.stamp(iter.block_begin(block), iter.block_begin(block) + iter.id_span(block).size());
+
+                        std::apply([&callback, &iter, &block](auto... columns)
+                        {
+                            callback(iter.id_span(block), columns...);
+                        }, 
+                        iter.columns(block));
+                    }
+                }
+            }
+
+            /**
+             * Parallel version of for_each.
+             *
+             * Every matching pool is split into index ranges that span a whole
+             * number of cache lines for each component. Column blocks start on a
+             * cache line, so neighbouring slices never share one. The range size
+             * is derived from the total entity count, so large pools are split 
+             * into many slices and small pools into few, which keeps the workers 
+             * balanced. Every worker stamps the mutable components of its slice.
+             *
+             * @tparam Callback Must be invocable<Extraction<Cs...>> and safe to
+             * call concurrently for different entities.
+             *
+             * @param pool The thread pool to run on.
+             * @param callback The callback to execute for each entity.
+             */
+            template <typename Callback>
+            void par_for_each(ThreadPool& pool, Callback&& callback)
+            {
+                NECS_TRACE_SCOPE("Query::par_for_each");
+
+                static_assert(std::is_invocable_v<Callback, Extraction<Cs...>>, "For each callback must take Extraction<Cs...> as argument.");
+
+                struct Slice
+                {
+                    Iterator<Cs...> iter;
+                    size_t first; // The pool index of ids[0].
+                    std::span<const EntityId> ids;
+                    Data<std::span<Cs>...> columns;
+                    size_t begin;
+                    size_t end;
+                };
+
+                // Number of entities per slice unit, so that no two slices share a cache line.
+                size_t align = 1;
+                ((align = std::lcm(align, CACHE_LINE / std::gcd(CACHE_LINE, sizeof(Cs)))),...);
+
+                size_t total = 0;
+
+                for (size_t i = 0; i < size(); i++)
+                {
+                    if (is_occupied(i)) total += chunk(i).size();
+                }
+
+                if (total == 0) return;
+
+                size_t target = std::max<size_t>(1, pool.size() * SLICES_PER_WORKER);
+                size_t grain = (total + target - 1) / target;
+                grain = std::max(align, (grain + align - 1) / align * align);
+
+                std::vector<Slice> slices;
+
+                for (size_t i = 0; i < size(); i++)
+                {
+                    if (!is_occupied(i)) continue;
+
+                    Iterator<Cs...> iter = chunk(i);
+
+                    // Slices never cross blocks, so that every slice is contiguous.
+                    for (size_t block = 0; block < iter.blocks(); block++)
+                    {
+                        std::span<const EntityId> ids = iter.id_span(block);
+
+                        for (size_t begin = 0; begin < ids.size(); begin += grain)
+                        {
+                            slices.push_back({iter, iter.block_begin(block), ids, iter.columns(block), begin, std::min(begin + grain, ids.size())});
+                        }
+                    }
+                }
+
+                pool.run(slices.size(), [&slices, &callback](size_t index)
+                {
+                    auto& [iter, first, ids, columns, begin, end] = slices[index];
+                    CommandKey& key = CommandKey::current();
+
+                    iter.stamp(first + begin, first + end);
+
+                    for (size_t i = begin; i < end; i++)
+                    {
+                        // Commands are keyed by entity, the task scope restores the key after.
+                        key.item = static_cast<uint64_t>(ids[i]) + 1;
+                        key.sequence = 0;
+
+                        callback(Extraction<Cs...>{ids[i], std::tie(std::get<std::span<Cs>>(columns)[i]...)});
+                    }
+                });
+            }
+
+            // Continues in the current pool, then moves on to the next occupied one.
+            bool operator!=(std::default_sentinel_t) 
+            {
+                while (m_current < m_size)
+                {
+                    if (m_iterator != std::default_sentinel) return true;
+
+                    m_current++;
+                    seek();
+                }
+
+                return false;
+            }
+    
+            auto operator*() -> Extraction<Cs...>
+            {    
+                return *m_iterator;
+            }
+    
+            Query<Cs...>& operator++() 
+            {    
+                ++m_iterator;
+                return *this;
+            }
+
+            Query<Cs...>& begin() 
+            {
+                m_current = 0;
+                seek();
+                return *this;
+            }
+    
+            auto end() const -> std::default_sentinel_t
+            {
+                return std::default_sentinel;
+            }    
+    };  
+
+    /**
+     * A query filtered on change ticks, created with Registry::query_changed 
+     * and Registry::query_added.
+     * 
+     * Only entities with a tick greater than since are visited. Chunks of 
+     * entities that have not changed are skipped without reading their ticks.
+     * Unlike Query, it never stamps the components it hands out.
+     */
+    template <typename... Cs>
+    class Changes
+    {
+        Query<Cs...> m_query;
+        Tick m_since;
+
+        public: 
+            Changes(Query<Cs...> query, Tick since) 
+                : m_query(query), m_since(since) {}
+
+            /**
+             * Calls the callback for every entity that changed since the tick.
+             * 
+             * @tparam Callback Must be invocable<Extraction<Cs...>>.
+             */
+            template <typename Callback>
+            void for_each(Callback&& callback)
+            {
+                NECS_TRACE_SCOPE("Changes::for_each");
+
+                static_assert(std::is_invocable_v<Callback, Extraction<Cs...>>, "For each callback must take Extraction<Cs...> as argument.");
+
+                for (size_t i = 0; i < m_query.size(); i++)
+                {
+                    if (!m_query.is_occupied(i)) continue;
+
+                    Iterator<Cs...> iter = m_query.chunk(i);
+                    const Ticks& ticks = *m_query.ticks(i);
+                    size_t shift = ticks.chunk_shift();
+                    size_t count = iter.size();
+
+                    for (size_t chunk = 0; (chunk << shift) < count; chunk++)
+                    {
+                        if (ticks.chunk(chunk) <= m_since) continue;
+
+                        size_t end = std::min(count, (chunk + 1) << shift);
+
+                        for (size_t index = chunk << shift; index < end; index++)
+                        {
+                            if (ticks.entity(index) > m_since) callback(iter[index]);
+                        }
+                    }
+                }
+            }
+
+            /**
+             * Calls the callback with contiguous spans over every chunk that 
+             * contains a change since the tick. Chunks are not filtered per 
+             * entity, so they can contain unchanged entities as well.
+             * 
+             * @tparam Callback Must be invocable<std::span<const EntityId>, std::span<Cs>...>.
+             */
+            template <typename Callback>
+            void each_chunk(Callback&& callback)
+            {
+                NECS_TRACE_SCOPE("Changes::each_chunk");
+
+                static_assert(std::is_invocable_v<Callback, std::span<const EntityId>, std::span<Cs>...>, "Each chunk callback must take std::span<const EntityId>, std::span<Cs>... as arguments.");
+
+                for (size_t i = 0; i < m_query.size(); i++)
+                {
+                    if (!m_query.is_occupied(i)) continue;
+
+                    Iterator<Cs...> iter = m_query.chunk(i);
+                    const Ticks& ticks = *m_query.ticks(i);
+                    size_t shift = ticks.chunk_shift();
+                    size_t count = iter.size();
+
+                    for (size_t chunk = 0; (chunk << shift) < count; chunk++)
+                    {
+                        if (ticks.chunk(chunk) <= m_since) continue;
+
+                        // Chunks never cross blocks, see TICK_CHUNK_SHIFT.
+                        size_t first = chunk << shift;
+                        size_t length = std::min(count, (chunk + 1) << shift) - first;
+                        size_t block = iter.block_of(first);
+                        size_t offset = first - iter.block_begin(block);
+
+                        std::apply([&callback, &iter, &block, &offset, &length](auto... columns)
+                        {
+                            callback(iter.id_span(block).subspan(offset, length), columns.subspan(offset, length)...);
+                        }, 
+                        iter.columns(block));
+                    }
+                }
+            }
+    };
+
+    template <typename T>
+    struct is_query : std::false_type {};
+
+    template <typename... Cs>
+    struct is_query<Query<Cs...>> : std::true_type {};
+
+    // ----------------------------------------------------------------------------
+    // Command buffer
+    // ---------------------------------------------------------------------------- 
+
+    template <typename As>
+    class CommandBuffer;
+
+    /**
+     * Records structural changes and component writes to apply later.
+     * 
+     * A buffer is not synchronized, but separate buffers can be recorded into 
+     * from separate threads. The registry keeps one buffer per thread of its 
+     * thread pool (see Registry::commands) and applies them all at once in 
+     * Registry::flush. Every command is stored with the CommandKey of the 
+     * recording thread.
+     * 
+     * @tparam As... The archetypes of the registry.
+     */
+    template <typename... As>
+    class CommandBuffer<Data<As...>>
+    {
+        using Components = typename Filter::merge_types<As...>::type;
+
+        template <typename T>
+        using Keyed = std::vector<std::pair<CommandKey, T>>;
+
+        template <typename C>
+        using Writes = Keyed<std::pair<EntityId, C>>;
+
+        using Tasks = Keyed<std::pair<EntityId, EntityTask>>;
+
+        std::tuple<Keyed<As>...> m_created;
+        Tasks m_tasks;
+        typename WrapData<Components, Data, Writes>::type m_writes;
+
+        public: 
+            /**
+             * Records an entity to create.
+             * 
+             * @tparam A The archetype of the entity passed in.
+             * 
+             * @param entity The entity to create, moved in if it is an rvalue.
+             */
+            template <typename A>
+            void create(A&& entity)
+            {
+                created<std::remove_cvref_t<A>>().emplace_back(CommandKey::next(), std::forward<A>(entity));
+            }
+
+            /**
+             * Records a state change, applied through Registry::queue.
+             * 
+             * @param id The entity to change.
+             * @param task The type of task to queue for.
+             */
+            void queue(EntityId id, EntityTask task)
+            {
+                m_tasks.push_back({CommandKey::next(), {id, task}});
+            }
+
+            void kill(EntityId id) { queue(id, KILL); }
+
+            void snooze(EntityId id) { queue(id, SNOOZE); }
+
+            void wake(EntityId id) { queue(id, WAKE); }
+
+            /**
+             * Records a component write. Writes to dead entities or to entities 
+             * without the component are dropped when applied.
+             * 
+             * @tparam C The component to write.
+             * 
+             * @param id The entity to write to.
+             * @param component The new value of the component.
+             */
+            template <typename C>
+            void set(EntityId id, C&& component)
+            {
+                writes<std::remove_cvref_t<C>>().push_back({CommandKey::next(), {id, std::forward<C>(component)}});
+            }
+
+            template <typename A>
+            auto created() -> Keyed<A>&
+            {
+                return std::get<Keyed<A>>(m_created);
+            }
+
+            auto tasks() -> Tasks&
+            {
+                return m_tasks;
+            }
+
+            template <typename C>
+            auto writes() -> Writes<C>&
+            {
+                return std::get<Writes<C>>(m_writes);
+            }
+
+            bool empty() const
+            {
+                bool empty = m_tasks.empty();
+
+                ((empty = empty && std::get<Keyed<As>>(m_created).empty()),...);
+
+                std::apply([&empty](const auto&... writes)
+                {
+                    ((empty = empty && writes.empty()),...);
+                }, 
+                m_writes);
+
+                return empty;
+            }
+
+            // The bytes reserved for recorded commands.
+            size_t memory() const
+            {
+                size_t bytes = m_tasks.capacity() * sizeof(m_tasks[0]);
+
+                ((bytes += std::get<Keyed<As>>(m_created).capacity() * sizeof(std::pair<CommandKey, As>)),...);
+
+                std::apply([&bytes](const auto&... writes)
+                {
+                    ((bytes += writes.capacity() * sizeof(writes[0])),...);
+                }, 
+                m_writes);
+
+                return bytes;
+            }
+
+            // Clears all commands, keeping the memory for reuse.
+            void clear()
+            {
+                m_tasks.clear();
+
+                (std::get<Keyed<As>>(m_created).clear(),...);
+
+                std::apply([](auto&... writes) { (writes.clear(),...); }, m_writes);
+            }
+    };
+
+    // ----------------------------------------------------------------------------
+    // Debug
+    // ---------------------------------------------------------------------------- 
+
+    template <typename C>
+    concept Debuggable = requires(const C& component) 
+    {
+        { component.debug() };
+    };
+
+    /**
+     * Allows open access to entity data in development. 
+     *
+     * Prints debug logs for entities + components if their components are Debbugable. 
+     * Since all the data is public, custom logs can be easily implemented externally.
+     */
+    template <typename... As>
+    struct Debugger 
+    {
+        Entities& entities;
+        std::tuple<Storage<As>...>& storages;
+
+        bool sleeping_pool = false;
+
+        template <typename A>
+        auto storage() -> Storage<A>&
+        {
+            return std::get<Storage<A>>(storages);
+        }
+
+        template <typename A>
+        bool is_type(EntityId id) 
+        {
+            return entities.is_current(id) && info(id).archetype == Filter::index_of<A, Data<As...>>::value;
+        }
+
+        auto info(EntityId id) -> EntityInfo
+        {
+            return entities.info(id);
+        }
+
+        template <typename A>
+        auto view_entity(EntityId id)
+        {
+            return [this, &id]<typename... Cs>(Data<Cs...>)
+            {
+                return view_components<A, Cs...>(id);
+            }
+            (A{});
+        }
+
+        template <typename A, typename... Cs>
+        auto view_components(EntityId id) -> View<Cs...>
+        {
+            EntityInfo i = info(id);
+
+            if (i.state == DEAD || !is_type<A>(id))
+            {
+                return std::nullopt;
+            }
+
+            return storage<A>().pool(is_sleeping(i.state)).template get<Cs...>(i.index);
+        }
+        
+        template <typename A>
+        void print_entity(EntityId id) 
+        {
+            if (!is_type<A>(id))
+            {
+                std::cout << "----------------------------------------\n";
+                std::cout << "|---INCORRECT TYPE---|\n";
+                std::cout << "----------------------------------------\n";       
+                return;         
+            }
+
+            auto e = view_entity<A>(id);
+
+            if (!e.has_value())
+            {
+                std::cout << "----------------------------------------\n";
+                std::cout << "|---NOT FOUND---|\n";
+                std::cout << "----------------------------------------\n";       
+                return;         
+            }
+
+            EntityInfo i = info(id);
+            auto state = [&i]()
+            {
+                switch(i.state)
+                {
+                    case LIVE: return "LIVE";
+                    case DEAD: return "DEAD";
+                    case SLEEPING: return "SLEEPING";
+                    case KILLED: return "KILLED";
+                    case SNOOZED: return "SNOOZED";
+                    case AWAKE: return "AWAKE";
+                    default: return "ERROR";
+                }
+            };
+            
+            std::cout << "----------------------------------------\n";
+            std::cout << "Entity ID: " << id
+                        << " (Index: " << i.index
+                        << ", State: " << state() << ")\n";
+            std::cout << "Components:\n";
+
+            auto f = [this]<typename C>(C& component)
+            {
+                if constexpr (Debuggable<C>)
+                {
+                    component.debug();
+                    std::cout << "\n";
+                }
+                else
+                {
+                    std::cout << "  - " << typeid(C).name() << ":";
+                    std::cout << "<not implemented>\n";
+                }
+            };
+
+            [this, &f]<typename... Cs>(Data<Cs&...> entity)
+            {
+                (f(std::get<Cs&>(entity)),...);
+            }
+            (e.value());
+
+            std::cout << "----------------------------------------\n";
+        };
+
+        template <typename A>
+        void print_storage(std::string archetype_name = typeid(A).name()) 
+        {
+            Storage<A>& s = storage<A>();
+
+            Pool<A>& pool = sleeping_pool ? s.sleeping : s.living;
+
+            std::cout << "\n[Archetype: " << archetype_name << "]";
+            std::cout << "\n[Storage type: " << (sleeping_pool ? "Sleeping" : "Living") << "]\n";
+
+            if (pool.count() == 0) 
+            {
+                std::cout << "----------------------------------------\n";
+                std::cout << "|---EMPTY---|\n";
+                std::cout << "----------------------------------------\n";
+                return;
+            };
+
+            for (size_t index = 0; index < pool.count(); index++)
+            {
+                print_entity<A>(pool.ids()[index]);
+            }
+        };
+
+        void print_all() 
+        {
+            std::cout << "\n==== NECS Debug ====\n";
+
+            (print_storage<As>(),...);
+
+            std::cout << "\n";
+        };
+    };
+
+    // ----------------------------------------------------------------------------
+    // Registry
+    // ---------------------------------------------------------------------------- 
+
+    /**
+     * The main API / entry point for interacting with system data.
+     * Contains functions for creating, removing & querying entities.
+     * 
+     * Queries listed in Queries (a Data<Query<Cs...>...>) have their pool 
+     * tables built when the registry is constructed, every other query builds 
+     * its table on first use.
+     * 
+     * Observed is the event policy, see ObserveAll. Built-in events left out 
+     * of it cost nothing when creating or updating entities.
+     */
+    template 
+    <
+        typename Archetypes, 
+        typename Events, 
+        typename Singletons,
+        typename Queries = Data<>,
+        typename Observed = ObserveAll
+    >
+    class Registry
+    {
+        using ArchetypeSignatures = Signatures<Archetypes>;
+        using EventListeners = Listeners<Archetypes, Events, Observed>;
+
+        Entities m_entities;
+        Storages<Archetypes> m_storages;
+        EventListeners m_listeners;
+        Singletons m_singletons;
+        std::unique_ptr<ThreadPool> m_workers;
+
+        // Occupancy of the living and sleeping pools, maintained by the pools themselves.
+        std::array<Occupancy<std::tuple_size_v<Archetypes>>, 2> m_occupancy = {};
+
+        Subscription m_subscriptions = 0;
+
+        // The tick that changes are currently stamped with.
+        Tick m_tick = 1;
+
+        // Query tables by query slot, see query_slot.
+        std::vector<std::shared_ptr<void>> m_queries;
+        static inline std::atomic<size_t> s_query_slots = 0;
+
+        // Pending state changes of one archetype, reused across updates.
+        struct Batch
+        {
+            std::vector<EntityId> ids;
+            std::vector<size_t> indices;
+        };
+
+        std::array<Batch, std::tuple_size_v<Archetypes>> m_batches;
+        std::vector<EntityId> m_updating;
+
+        // The last command epoch handed out, see next_epoch.
+        uint64_t m_epoch = 0;
+
+        // Archetypes whose pools allocate from a resource that is not safe to share between threads.
+        std::array<bool, std::tuple_size_v<Archetypes>> m_unsynchronized = {};
+
+        // One command buffer for the thread that made the registry, followed by one per worker.
+        std::vector<CommandBuffer<Archetypes>> m_commands = std::vector<CommandBuffer<Archetypes>>(1);
+        std::thread::id m_owner = std::this_thread::get_id();
+
+        // Buffers of every other thread, registered on first use. A deque keeps them in place.
+        std::deque<CommandBuffer<Archetypes>> m_thread_commands;
+        std::vector<std::pair<std::thread::id, CommandBuffer<Archetypes>*>> m_thread_buffers;
+        std::mutex m_thread_mutex;
+        size_t m_serial = s_serials++;
+        static inline std::atomic<size_t> s_serials = 1;
+
+        bool m_run_callbacks = true;
+
+        TrimPolicy m_trim_policy;
+        size_t m_trim_cursor = 0;
+        
+        // ---- Private access ---- //
+
+        template <typename A>
+        auto storage() -> Storage<A>&
+        {
+            return std::get<Storage<A>>(m_storages);
+        }
+
+        template <typename A>
+        auto pool(bool sleeping_pool) -> Pool<A>&
+        {
+            return storage<A>().pool(sleeping_pool);
+        }
+
+        template <typename E>
+        auto listener() -> Listener<E>&
+        {
+            return std::get<Listener<E>>(m_listeners);
+        }
+
+        // ---- Utils ---- //
+
+        void validate(EntityId id)
+        {
+            if (id_slot(id) >= total())
+            {
+                std::cout << "Invalid EntityId: " << id;
+                throw std::invalid_argument("Invalid EntityId");
+            }
+        }
+
+        // Whether the event has a listener, events left out by the policy compile out.
+        template <typename E>
+        static constexpr bool observes = Filter::has_type<Listener<E>, EventListeners>::value;
+
+        // Whether updating an archetype fires any observed DataUpdated event.
+        template <typename A>
+        static constexpr bool observes_update = []<typename... Cs>(Data<Cs...>)
+        {
+            return observes<DataUpdated<A>> || (observes<DataUpdated<Cs>> || ...);
+        }
+        (A{});
+
+        static constexpr bool observes_updates = []<typename... As>(Data<As...>)
+        {
+            return (observes_update<As> || ...);
+        }
+        (Archetypes{});
+
+        template <typename A>
+        void on_update()
+        {
+            call<DataUpdated<A>>({});
+
+            [this]<typename... Cs>(Data<Cs...>)
+            {
+                ((call<DataUpdated<Cs>>({})),...);
+            }
+            (A{});
+        }
+
+        template <typename A>
+        static constexpr ArchetypeId archetype_id = Filter::index_of<A, Archetypes>::value;
+
+        static constexpr bool snapshot_serializable = []<typename... As>(std::type_identity<Data<As...>>)
+        {
+            return ([]<typename... Cs>(std::type_identity<Data<Cs...>>)
+            {
+                return (Serializable<Cs> && ...);
+            }
+            (std::type_identity<As>{}) && ...);
+        }
+        (std::type_identity<Archetypes>{}) 
+        && []<typename... Ss>(std::type_identity<Data<Ss...>>)
+        {
+            return (Serializable<Ss> && ...);
+        }
+        (std::type_identity<Singletons>{});
+
+        /**
+         * Describes the archetypes of a snapshot: id and slot widths, then 
+         * for every archetype its component count and each component's size. 
+         * Loading checks it against the loading registry.
+         */
+        static auto snapshot_layout() -> std::vector<uint64_t>
+        {
+            std::vector<uint64_t> layout = {sizeof(EntityId), SLOT_BITS, std::tuple_size_v<Archetypes>};
+
+            []<typename... As>(std::type_identity<Data<As...>>, std::vector<uint64_t>& layout)
+            {
+                auto f = []<typename... Cs>(std::type_identity<Data<Cs...>>, std::vector<uint64_t>& layout)
+                {
+                    layout.push_back(sizeof...(Cs));
+                    (layout.push_back(sizeof(Cs)),...);
+                };
+
+                (f(std::type_identity<As>{}, layout),...);
+            }
+            (std::type_identity<Archetypes>{}, layout);
+
+            return layout;
+        }
+
+        /**
+         * Allocates metadata for a block of living entities, reserves room for 
+         * them in the pool and lets build add them. If building throws, the pool 
+         * is rolled back and the block's slots are released before rethrowing, 
+         * so no metadata is left pointing at entities that were never added.
+         * 
+         * @tparam Build Must be invocable<Pool<A>&, std::span<const EntityId>>, 
+         * called with the ids of the block in pool order.
+         * 
+         * @returns The ids of the block.
+         */
+        template <typename A, typename Build>
+        auto create_block(size_t count, Build&& build) -> std::vector<EntityId>
+        {
+            Pool<A>& p = pool<A>(false);
+            size_t end = p.count();
+            size_t total = p.total();
+
+            std::vector<EntityId> ids = m_entities.create_block
+            ({
+                archetype_id<A>, 
+                static_cast<PoolIndex>(end), 
+                LIVE
+            }, count);
+
+            try 
+            {
+                p.grow(count);
+                build(p, std::span<const EntityId>(ids));
+            }
+            catch (...)
+            {
+                p.rollback(end, total);
+                for (EntityId id : ids) m_entities.discard(id);
+                throw;
+            }
+
+            on_populate<A>(ids);
+
+            return ids;
+        }
+
+        // Creates recorded entities as one batch, which takes dead slots first like create does.
+        template <typename A>
+        void create_deferred(std::vector<std::pair<CommandKey, A>>& created)
+        {
+            populate<A>(created.size(), [&created](size_t i) { return std::move(created[i].second); });
+        }
+
+        template <typename A, typename Entity>
+        auto add(Entity&& entity) -> EntityId
+        {
+            Pool<A>& p = pool<A>(false);
+
+            EntityId id = m_entities.create
+            ({
+                archetype_id<A>, 
+                static_cast<PoolIndex>(p.count()), 
+                LIVE
+            });
+
+            p.add(id, std::forward<Entity>(entity));
+
+            on_create<A>(id);
+
+            return id;
+        }
+
+        template <typename A>
+        void on_create([[maybe_unused]] EntityId id)
+        {
+            if constexpr (observes<EntityCreated> || observes_update<A>)
+            {
+                if (m_run_callbacks) 
+                {
+                    call<EntityCreated>({id});
+                    on_update<A>();
+                }
+            }
+        }
+
+        template <typename A>
+        void on_populate([[maybe_unused]] const std::vector<EntityId>& ids)
+        {
+            if constexpr (observes<EntitiesCreated> || observes_update<A>)
+            {
+                if (m_run_callbacks && !ids.empty()) 
+                {
+                    // The event owns a copy of the ids, only made if anyone listens.
+                    if constexpr (observes<EntitiesCreated>)
+                    {
+                        if (listener<EntitiesCreated>().is_active()) call<EntitiesCreated>({ids});
+                    }
+
+                    on_update<A>();
+                }
+            }
+        }
+
+        // Applies a pending state change through the handler of the entity's archetype.
+        void dispatch(EntityId id)
+        {
+            using Handler = void (Registry::*)(EntityId);
+
+            static constexpr auto handlers = []<typename... As>(Data<As...>)
+            {
+                return std::array<Handler, sizeof...(As)>{&Registry::apply<As>...};
+            }
+            (Archetypes{});
+
+            (this->*handlers[m_entities.archetypes[id_slot(id)]])(id);
+        }
+
+        template <typename A>
+        void apply(EntityId id)
+        {
+            auto& s = storage<A>();
+            PoolIndex& index = m_entities.indices[id_slot(id)];
+            EntityState& state = m_entities.states[id_slot(id)];
+            
+            switch (state)
+            {
+                case AWAKE:
+                {
+                    s.sleeping.relocate(index, s.living); // move entity into living
+                    EntityId swapped_entity = s.sleeping.remove(index);
+                    m_entities.indices[id_slot(swapped_entity)] = index;
+                    index = s.living.count() - 1;
+                    break;
+                };
+                case KILLED: 
+                {
+                    EntityId swapped_entity = s.living.remove(index);
+                    m_entities.indices[id_slot(swapped_entity)] = index;
+                    m_entities.release(id);
+                    break;
+                };
+                case SNOOZED:
+                {
+                    s.living.relocate(index, s.sleeping); // move entity into sleeping
+                    EntityId swapped_entity = s.living.remove(index);
+                    m_entities.indices[id_slot(swapped_entity)] = index;
+                    index = s.sleeping.count() - 1;
+                    break;
+                };
+                default:
+                {
+                    return;
+                };
+            }
+
+            EntityState req_state = state;
+            EntityState res_state = 
+                req_state == AWAKE 
+                ? LIVE
+                : req_state == KILLED
+                ? DEAD
+                : SLEEPING;
+
+            m_entities.counter[req_state]--;
+            m_entities.counter[res_state]++;
+            state = res_state;
+
+            if constexpr (observes<EntityUpdated> || observes_update<A>)
+            {
+                if (m_run_callbacks) 
+                {
+                    call<EntityUpdated>({id, req_state, res_state});
+                    on_update<A>();
+                }
+            }
+        }
+
+        /**
+         * Applies the pending state changes of one archetype in bulk.
+         * 
+         * Entities leaving a pool are relocated in ascending index order, so 
+         * that they keep their relative order in the pool they are appended to, 
+         * and are then removed from their old pool all at once. Only touches the 
+         * archetype's storage and the metadata of the moved entities, so 
+         * different archetypes can be processed in parallel.
+         * 
+         * @tparam A The archetype of the batch.
+         * 
+         * @param batch The archetype's pending entities.
+         * @param preserve_order Whether to compact pools instead of swapping.
+         */
+        template <typename A>
+        void apply_batch(Batch& batch, bool preserve_order)
+        {
+            NECS_TRACE_SCOPE("Registry::apply_batch");
+
+            auto& s = storage<A>();
+            auto& indices = m_entities.indices;
+            auto& states = m_entities.states;
+
+            auto index = [&indices](EntityId id) -> size_t { return indices[id_slot(id)]; };
+            auto moved = [&indices](EntityId id, size_t index) { indices[id_slot(id)] = index; };
+
+            auto transfer = [&](auto begin, auto end, Pool<A>& from, Pool<A>& to)
+            {
+                std::sort(begin, end, [&index](EntityId a, EntityId b) { return index(a) < index(b); });
+
+                batch.indices.clear();
+
+                for (auto it = begin; it != end; ++it)
+                {
+                    batch.indices.push_back(index(*it));
+
+                    if (states[id_slot(*it)] != KILLED)
+                    {
+                        from.relocate(index(*it), to);
+                        indices[id_slot(*it)] = to.count() - 1;
+                    }
+                }
+
+                from.remove_many(batch.indices, preserve_order, moved);
+            };
+
+            // Waking entities are located in the sleeping pool, the rest in the living pool.
+            auto split = std::partition(batch.ids.begin(), batch.ids.end(), [&states](EntityId id) 
+            { 
+                return states[id_slot(id)] == AWAKE; 
+            });
+
+            transfer(batch.ids.begin(), split, s.sleeping, s.living);
+            transfer(split, batch.ids.end(), s.living, s.sleeping);
+
+            for (EntityId id : batch.ids)
+            {
+                EntityState& state = states[id_slot(id)];
+
+                state = state == AWAKE 
+                    ? LIVE 
+                    : state == KILLED 
+                    ? DEAD 
+                    : SLEEPING;
+            }
+
+            batch.ids.clear();
+        }
+
+        // ---- Queries ---- //
+
+        // A unique index into m_queries for every combination of query components and filters.
+        template <typename... Key>
+        static size_t query_slot()
+        {
+            static const size_t slot = s_query_slots.fetch_add(1, std::memory_order_relaxed);
+            return slot;
+        }
+
+        // Gets the cached table of a query, building it on first use.
+        template <typename Ws, typename Wos, typename Tracked, typename... Cs>
+        auto table() -> QueryTable<Cs...>&
+        {
+            size_t slot = query_slot<QueryTable<Cs...>, Ws, Wos, Tracked>();
+
+            if (slot >= m_queries.size()) m_queries.resize(slot + 1);
+
+            if (!m_queries[slot])
+            {
+                NECS_TRACE_SCOPE("Registry::build_query_table");
+
+                m_queries[slot] = std::make_shared<QueryTable<Cs...>>
+                (
+                    std::type_identity<Archetypes>{}, 
+                    std::type_identity<Tracked>{}, 
+                    match<Ws, Wos>()
+                );
+            }
+
+            return *static_cast<QueryTable<Cs...>*>(m_queries[slot].get());
+        }
+
+        template <typename Ws, typename Wos, typename... Cs>
+        auto make_query(bool sleeping_pool) -> Query<Cs...>
+        {
+            return make_tracked_query<Ws, Wos, void, Cs...>(sleeping_pool);
+        }
+
+        template <typename Ws, typename Wos, typename Tracked, typename... Cs>
+        auto make_tracked_query(bool sleeping_pool) -> Query<Cs...>
+        {
+            NECS_TRACE_SCOPE("Registry::query");
+
+            QueryTable<Cs...>& t = table<Ws, Wos, Tracked, Cs...>();
+            return Query<Cs...>(sleeping_pool ? t.sleeping : t.living, m_occupancy[sleeping_pool].data());
+        }
+
+        template <typename A>
+        void track()
+        {
+            constexpr ArchetypeId id = archetype_id<A>;
+            constexpr uint64_t bit = uint64_t(1) << (id % 64);
+
+            storage<A>().living.track(&m_occupancy[0][id / 64], bit);
+            storage<A>().sleeping.track(&m_occupancy[1][id / 64], bit);
+
+            storage<A>().living.clock(&m_tick);
+            storage<A>().sleeping.clock(&m_tick);
+        }
+
+        // Gets the components of the entity in a metadata slot, known to be of archetype A.
+        template <typename A, typename... Cs>
+        auto find_in(size_t slot) -> View<Cs...>
+        {
+            return storage<A>().template get<Cs...>(m_entities.indices[slot], is_sleeping(m_entities.states[slot]));
+        }
+
+        // The find_in entry of archetype A, nullptr if A lacks any of Cs.
+        template <typename A, typename... Cs>
+        static constexpr auto finder() -> View<Cs...> (Registry::*)(size_t)
+        {
+            if constexpr (ArchetypeSignatures::template of_data<A>.contains(ArchetypeSignatures::template of<Cs...>))
+            {
+                return &Registry::find_in<A, Cs...>;
+            }
+            else 
+            {
+                return nullptr;
+            }
+        }
+
+        // Checks that a slot that is not dead points to its own id in a pool of archetype A.
+        template <typename A>
+        bool holds(size_t slot)
+        {
+            Pool<A>& p = pool<A>(is_sleeping(m_entities.states[slot]));
+            size_t index = m_entities.indices[slot];
+
+            return index < p.count() && p.ids()[index] == make_id(slot, m_entities.generations[slot]);
+        }
+
+        // Checks that the loaded metadata and pools agree, so that no lookup goes out of bounds.
+        void check_loaded()
+        {
+            using Holder = bool (Registry::*)(size_t);
+
+            static constexpr auto holders = []<typename... As>(std::type_identity<Data<As...>>)
+            {
+                return std::array<Holder, sizeof...(As)>{&Registry::holds<As>...};
+            }
+            (std::type_identity<Archetypes>{});
+
+            for (size_t slot = 0; slot < m_entities.size(); slot++)
+            {
+                if (m_entities.states[slot] == DEAD) continue;
+
+                if (!(this->*holders[m_entities.archetypes[slot]])(slot))
+                {
+                    throw std::runtime_error("@Registry::load - snapshot metadata does not match its pools.");
+                }
+            }
+
+            // Every pooled entity must be one of the slots checked above.
+            size_t living = 0;
+            size_t sleeping = 0;
+
+            [this, &living, &sleeping]<typename... As>(std::type_identity<Data<As...>>)
+            {
+                ((living += pool<As>(false).count(), sleeping += pool<As>(true).count()),...);
+            }
+            (std::type_identity<Archetypes>{});
+
+            const auto& counter = m_entities.counter;
+
+            if (living != counter[LIVE] + counter[KILLED] + counter[SNOOZED] || sleeping != counter[SLEEPING] + counter[AWAKE])
+            {
+                throw std::runtime_error("@Registry::load - snapshot pools do not match its metadata.");
+            }
+        }
+
+        // Stamps component C of the entity in a metadata slot, known to be of archetype A and alive.
+        template <typename A, typename C>
+        void mark_in(size_t slot)
+        {
+            storage<A>().pool(is_sleeping(m_entities.states[slot])).template mark<C>(m_entities.indices[slot]);
+        }
+
+        // The mark_in entry of archetype A, nullptr if A lacks C.
+        template <typename A, typename C>
+        static constexpr auto marker() -> void (Registry::*)(size_t)
+        {
+            if constexpr (ArchetypeSignatures::template of_data<A>.contains(ArchetypeSignatures::template of<C>))
+            {
+                return &Registry::mark_in<A, C>;
+            }
+            else 
+            {
+                return nullptr;
+            }
+        }
+
+        // Shrinks a pool if it is sparser than the trim policy allows.
+        template <typename A>
+        void shrink_sparse(bool sleeping_pool)
+        {
+            Pool<A>& p = pool<A>(sleeping_pool);
+            size_t capacity = p.capacity();
+
+            if (capacity > m_trim_policy.min_capacity && p.count() < m_trim_policy.shrink_below * capacity)
+            {
+                p.shrink();
+            }
+        }
+
+        template <typename A>
+        size_t pool_memory(bool sleeping_pool)
+        {
+            return pool<A>(sleeping_pool).memory();
+        }
+
+        template <typename A>
+        size_t pool_unused_memory(bool sleeping_pool)
+        {
+            return pool<A>(sleeping_pool).unused_memory();
+        }
+
+        template <typename A>
+        void shrink_pool(bool sleeping_pool)
+        {
+            pool<A>(sleeping_pool).shrink();
+        }
+
+        // Pool operations by archetype id, taking whether to use the sleeping pool.
+        template <typename R>
+        using PoolOps = std::array<R (Registry::*)(bool), std::tuple_size_v<Archetypes>>;
+
+        /**
+         * Applies the trim policy. shrink_below checks pools_per_update pools 
+         * per call, continuing where the last call stopped, and the memory 
+         * budget shrinks the pools with the most unused memory until it holds.
+         */
+        void maintain()
+        {
+            constexpr size_t pools = std::tuple_size_v<Archetypes> * 2;
+
+            static constexpr auto sparse = []<typename... As>(std::type_identity<Data<As...>>)
+            {
+                return PoolOps<void>{&Registry::shrink_sparse<As>...};
+            }
+            (std::type_identity<Archetypes>{});
+
+            if (m_trim_policy.shrink_below > 0)
+            {
+                NECS_TRACE_SCOPE("Registry::maintain");
+
+                size_t steps = m_trim_policy.pools_per_update == 0 ? pools : std::min(m_trim_policy.pools_per_update, pools);
+
+                for (size_t i = 0; i < steps; i++)
+                {
+                    (this->*sparse[m_trim_cursor / 2])(m_trim_cursor % 2);
+                    m_trim_cursor = (m_trim_cursor + 1) % pools;
+                }
+            }
+
+            if (m_trim_policy.memory_budget > 0) 
+            {
+                NECS_TRACE_SCOPE("Registry::enforce_budget");
+                enforce_budget();
+            }
+        }
+
+        void enforce_budget()
+        {
+            constexpr size_t pools = std::tuple_size_v<Archetypes> * 2;
+
+            static constexpr auto tables = []<typename... As>(std::type_identity<Data<As...>>)
+            {
+                return std::make_tuple
+                (
+                    PoolOps<size_t>{&Registry::pool_memory<As>...},
+                    PoolOps<size_t>{&Registry::pool_unused_memory<As>...},
+                    PoolOps<void>{&Registry::shrink_pool<As>...}
+                );
+            }
+            (std::type_identity<Archetypes>{});
+
+            auto& [memory, unused, shrink] = tables;
+
+            size_t total = 0;
+            std::array<std::pair<size_t, size_t>, pools> slack;
+
+            for (size_t p = 0; p < pools; p++)
+            {
+                total += (this->*memory[p / 2])(p % 2);
+                slack[p] = {(this->*unused[p / 2])(p % 2), p};
+            }
+
+            if (total <= m_trim_policy.memory_budget) return;
+
+            std::sort(slack.begin(), slack.end(), std::greater<>{});
+
+            for (auto [bytes, p] : slack)
+            {
+                if (total <= m_trim_policy.memory_budget || bytes == 0) break;
+
+                size_t before = (this->*memory[p / 2])(p % 2);
+                (this->*shrink[p / 2])(p % 2);
+                total -= before - (this->*memory[p / 2])(p % 2);
+            }
+        }
+
+        template <typename Ws = Data<>, typename Wos = Data<>>
+        auto match()
+        {
+            return [this] <size_t... Is>(std::index_sequence<Is...>)
+            {
+                return std::tie(std::get<Is>(m_storages)...);
+            }
+            (typename Signatures<Archetypes>::template Match<Ws, Wos>{});
+        }
+
+        public:
+            // The component signature of the registry's archetypes, see Signatures.
+            using Signature = typename ArchetypeSignatures::Type;
+
+            Registry()
+            {
+                [this]<typename... As>(std::type_identity<Data<As...>>)
+                {
+                    ((track<As>()),...);
+                }
+                (std::type_identity<Archetypes>{});
+
+                [this]<typename... Qs>(std::type_identity<Data<Qs...>>)
+                {
+                    ((query<Qs>()),...);
+                }
+                (std::type_identity<Queries>{});
+            }
+
+            // ---- Checks ---- //
+
+            /**
+             * Performs a runtime typecheck on the entity.
+             * 
+             * @tparam A The archetype to check.
+             * 
+             * @param id The entity to check.
+             * 
+             * @returns True is the type matches the type in the entity 
+             * metadata, false if not.
+             */
+            template <typename A>
+            bool is_type(EntityId id) 
+            {
+                return m_entities.is_current(id) && m_entities.archetypes[id_slot(id)] == archetype_id<A>;
+            }
+
+            /**
+             * Performs a state check on the entity.
+             * 
+             * @param id The entity to check.
+             * @param state The state to check.
+             * 
+             * @returns True if state matches the state in the entity 
+             * metadata, false if not.
+             */
+            bool is_state(EntityId id, EntityState state)
+            {
+                if (!m_entities.is_current(id)) return state == DEAD;
+
+                return m_entities.states[id_slot(id)] == state;
+            }
+
+            /**
+             * Checks if a handle refers to an entity that has not died yet.
+             * 
+             * @param id The entity to check.
+             * 
+             * @returns False if the handle is stale or the entity is DEAD.
+             */
+            bool is_alive(EntityId id)
+            {
+                return m_entities.is_current(id) && m_entities.states[id_slot(id)] != DEAD;
+            }
+
+            /**
+             * Performs a check on the pool.
+             * 
+             * @tparam A The archetype pool to check.
+             * 
+             * @param sleeping_pool False by default, checks sleeping pool if 
+             * true, living pool if false.
+             * 
+             * @returns True if the pool's non-dead entities are 0, false
+             * if not.
+             */
+            template <typename A>
+            bool is_empty(bool sleeping_pool = false)
+            {
+                return pool_count<A>(sleeping_pool) == 0;
+            }
+
+            /**
+             * Checks if the entity's archetype contains a component.
+             * 
+             * @tparam C The component to check for.
+             * 
+             * @param id The entity to check.
+             */
+            template <typename C>
+            bool has_component(EntityId id)
+            {
+                return m_entities.is_current(id) && 
+                    ArchetypeSignatures::archetypes[m_entities.archetypes[id_slot(id)]].test(ArchetypeSignatures::template bit<C>);
+            }
+
+            /**
+             * Gets the component signature of a set of components, for runtime 
+             * matching against entity signatures.
+             * 
+             * @tparam Cs... The components.
+             */
+            template <typename... Cs>
+            static constexpr auto signature() -> Signature
+            {
+                return ArchetypeSignatures::template of<Cs...>;
+            }
+
+            /**
+             * Gets the component signature of an entity's archetype.
+             * 
+             * @param id The entity to check.
+             * 
+             * @returns The signature, empty if the entity is dead.
+             */
+            auto signature(EntityId id) -> Signature
+            {
+                if (!m_entities.is_current(id)) return {};
+                return ArchetypeSignatures::archetypes[m_entities.archetypes[id_slot(id)]];
+            }
+
+            /**
+             * Checks an entity against a with/without filter at runtime.
+             * 
+             * @param id The entity to check.
+             * @param with The components the entity must have.
+             * @param without The components the entity must not have.
+             * 
+             * @returns False if the entity is dead or does not match.
+             */
+            bool matches(EntityId id, const Signature& with, const Signature& without = {})
+            {
+                return m_entities.is_current(id) && 
+                    ArchetypeSignatures::archetypes[m_entities.archetypes[id_slot(id)]].matches(with, without);
+            }
+
+            // ---- Counters ---- //
+
+            /**
+             * Gets the number of entity slots currently in the system.
+             * 
+             * This includes the slots of dead entities.
+             */
+            size_t total()
+            {
+                return m_entities.size();
+            }
+            
+            /**
+             * Gets the number of total entities in a state currently in the system.
+             * 
+             * @param state The state to check.
+             */
+            size_t state_total(EntityState state)
+            {
+                return m_entities.counter[state];
+            }
+
+            /**
+             * Gets the total capacity of a pool, iterable and dead.
+             * 
+             * @tparam A The archetype pool to check.
+             * 
+             * @param sleeping_pool False by default, checks sleeping pool if 
+             * true, living pool if false.     
+             */
+            template <typename A>
+            size_t pool_total(bool sleeping_pool = false)
+            {
+                return pool<A>(sleeping_pool).total();
+            }
+
+            /**
+             * Gets the iterable number of entities in a pool.
+             * 
+             * @tparam A The archetype pool to check.
+             * 
+             * @param sleeping_pool False by default, checks sleeping pool if 
+             * true, living pool if false.
+             */
+            template <typename A>
+            size_t pool_count(bool sleeping_pool = false)
+            {
+                return pool<A>(sleeping_pool).count();
+            }
+ 
+            // ---- Events ---- //
+
+            /**
+             * Adds a subscriber to an event channel. 
+             * 
+             * A callback taking E is called every time the event is fired. 
+             * A callback taking std::span<const E> is a batch subscriber: it is 
+             * called from dispatch_events() with every event fired since the last dispatch.
+             * 
+             * @tparam E The event of the listener. 
+             * @tparam Callback invocable<E> or invocable<std::span<const E>>. 
+             * 
+             * @param callback The function to call for this event.
+             * 
+             * @throws Callback is not invocable<E> or invocable<std::span<const E>>. 
+             * 
+             * @returns A handle to unsubscribe with.
+             */
+            template <typename E, typename Callback>
+            auto subscribe(Callback&& callback) -> Subscription
+            {
+                static_assert
+                (
+                    std::is_invocable_v<Callback, E> || std::is_invocable_v<Callback, std::span<const E>>, 
+                    "@Registry::subscribe: Event callback must take event or a span of events as argument."
+                );
+
+                static_assert(observes<E>, "@Registry::subscribe: Event is not observed by the registry's event policy.");
+
+                auto& l = listener<E>();
+                Subscription subscription = m_subscriptions++;
+
+                if constexpr (std::is_invocable_v<Callback, std::span<const E>>)
+                {
+                    l.batch_callbacks.emplace_back(subscription, std::forward<Callback>(callback));
+                }
+                else 
+                {
+                    l.callbacks.emplace_back(subscription, std::forward<Callback>(callback));
+                }
+
+                return subscription;
+            }
+
+            /**
+             * Removes a subscriber from an event channel. 
+             * Queued events are dropped when the last batch subscriber leaves.
+             * 
+             * @tparam E The event of the listener.
+             * 
+             * @param subscription The handle returned by subscribe.
+             * 
+             * @returns False if there was no such subscriber.
+             */
+            template <typename E>
+            bool unsubscribe(Subscription subscription)
+            {
+                if constexpr (observes<E>) return listener<E>().remove(subscription);
+                else return false;
+            }
+
+            /**
+             * Closes an event channel, no subscriber is called until it is opened again.
+             * 
+             * @tparam E The event of the listener.
+             */
+            template <typename E>
+            void close()
+            {
+                if constexpr (observes<E>) listener<E>().ready = false;
+            }
+
+            /**
+             * Opens a previously closed event channel.
+             * 
+             * @tparam E The event of the listener.
+             */
+            template <typename E>
+            void open()
+            {
+                if constexpr (observes<E>) listener<E>().ready = true;
+            }
+
+            /**
+             * Fires an event: immediate subscribers are called right away and 
+             * the event is queued for batch subscribers. Built-in events left 
+             * out of the event policy are dropped at compile time.
+             * 
+             * @tparam E The event of the listener.
+             * 
+             * @param event The event to pass to the callbacks.
+             */
+            template <typename E>
+            void call([[maybe_unused]] E event)
+            {
+                if constexpr (observes<E>)
+                {
+                    auto& l = listener<E>();
+                    if (l.ready) l.fire(event);
+                }
+            }
+
+            /**
+             * Hands every queued event of a channel over to its batch subscribers.
+             * 
+             * @tparam E The event of the listener.
+             */
+            template <typename E>
+            void dispatch_events()
+            {
+                if constexpr (observes<E>) listener<E>().dispatch();
+            }
+
+            /**
+             * Hands the queued events of every channel over to their batch 
+             * subscribers. Meant to be called once per frame.
+             */
+            void dispatch_events()
+            {
+                NECS_TRACE_SCOPE("Registry::dispatch_events");
+
+                std::apply([](auto&... listeners)
+                {
+                    (listeners.dispatch(),...);
+                }, 
+                m_listeners);
+            }
+
+            // ---- Data access  ---- //
+
+            /**
+             * Creates a debugger class to expose storages and entities. 
+             * 
+             * @returns A new debugger.
+             */
+            auto debugger()
+            {
+                return Debugger{m_entities, m_storages};
+            }
+
+            /**
+             * Gets a copy of the metadata of the entity's slot.
+             * 
+             * @throws The id is out of range.
+             */
+            auto info(EntityId id) -> EntityInfo
+            {
+                validate(id);
+                return m_entities.info(id);
+            }
+
+            /**
+             * Gets the entity's archetype id, its position in Archetypes.
+             * 
+             * @throws The id is out of range.
+             */
+            auto archetype(EntityId id) -> ArchetypeId
+            {
+                validate(id);
+                return m_entities.archetypes[id_slot(id)];
+            }
+            
+
+            /**
+             * Returns a read-only reference to the ids of a pool.
+             * 
+             * @tparam A The storage to get the pool from.
+             * 
+             * @param sleeping_pool Whether to get the sleeping pool or not.
+             */
+            template <typename A>
+            auto ids(bool sleeping_pool = false) -> const Column<EntityId>&
+            {
+                return pool<A>(sleeping_pool).ids();
+            }
+
+            /**
+             * Returns a read-only vector of components from a pool.
+             */
+            template <typename A, typename C>
+            auto vector(bool sleeping_pool = false) -> const Column<C>&
+            {
+                return pool<A>(sleeping_pool).template vector<C>();
+            }
+
+            /**
+             * Gets a singleton.
+             * 
+             * @tparam S The singleton's type.
+             * 
+             * @returns A reference to the singleton.
+             */
+            template <typename S>
+            auto singleton() -> S&
+            {   
+                return std::get<S>(m_singletons);
+            }
+
+            /**
+             * Gets the registry's thread pool, used for parallel iteration. 
+             * The pool is created on first use with one worker per hardware thread.
+             * 
+             * @returns A reference to the thread pool.
+             */
+            auto workers() -> ThreadPool&
+            {
+                if (!m_workers)
+                {
+                    m_workers = std::make_unique<ThreadPool>();
+                    m_commands.resize(m_workers->size() + 1);
+                }
+
+                return *m_workers;
+            }
+
+            /**
+             * Replaces the registry's thread pool with one of a given size.
+             * Must not be called while a parallel operation is running.
+             * 
+             * @param count The number of worker threads, 0 runs everything on 
+             * the calling thread.
+             */
+            void set_workers(size_t count)
+            {
+                m_workers = std::make_unique<ThreadPool>(count);
+                m_commands.resize(std::max(m_commands.size(), count + 1));
+            }
+
+            /**
+             * Constructs a single query.
+             * 
+             * The first query for a combination of components and filters builds 
+             * the table of matching pools, later ones reuse it and allocate nothing.
+             * Building must not race with other queries, so queries made from 
+             * worker threads should be declared in Queries.
+             * 
+             * @tparam Cs... The components to query for.
+             * 
+             * @param sleeping_pool False by default, updates the query
+             * for the sleeping pool if true, living pool if false. 
+             * 
+             * @returns A query object.
+             */
+            template <typename... Cs>
+                requires (!is_query<Cs>::value && ...)
+            auto query(bool sleeping_pool = false) -> Query<Cs...>
+            {
+                return make_query<Data<Cs...>, Data<>, Cs...>(sleeping_pool);
+            }
+
+            /**
+             * Constructs a query from its type, e.g. one declared in Queries.
+             * 
+             * @tparam Q A Query<Cs...> type.
+             * 
+             * @param sleeping_pool False by default, updates the query
+             * for the sleeping pool if true, living pool if false. 
+             * 
+             * @returns A query object.
+             */
+            template <typename Q>
+                requires is_query<Q>::value
+            auto query(bool sleeping_pool = false) -> Q
+            {
+                return [this, &sleeping_pool]<typename... Cs>(std::type_identity<Query<Cs...>>)
+                {
+                    return query<Cs...>(sleeping_pool);
+                }
+                (std::type_identity<Q>{});
+            }
+
+            /**
+             * Constructs an iterator for a single pool.
+             * 
+             * @tparam A The archetype storage to check. 
+             * @tparam Cs... The components to filter for. 
+             * 
+             * @param sleeping_pool False by default, iterates the
+             * sleeping pool if true, living pool if false.              
+             *  
+             * @returns The pool's iterator.
+             */
+            template <typename A, typename... Cs>
+            auto query_in(bool sleeping_pool = false) -> Iterator<Cs...>
+            {
+                return storage<A>().template iter<Cs...>(sleeping_pool);
+            }
+
+            /**
+             * Constructs a query with additional component constraints using `With`.
+             * Expands `With` into its constituent components and includes them in the match.
+             * 
+             * @tparam With A `Data<>` wrapper containing components to include in the match.
+             * @tparam Cs... The primary components to query for. This must be a set of 
+             * Query-compatible types.
+             * 
+             * @param sleeping_pool False by default, updates the query
+             * for the sleeping pool if true, living pool if false.
+             * 
+             * @returns A query including components from `With`.
+             */
+            template <typename With, typename... Cs>
+            auto query_with(bool sleeping_pool = false) -> Query<Cs...>
+            {
+                return [this, &sleeping_pool]<typename... Ws>(Data<Ws...>)
+                {
+                    return make_query<Data<Cs..., Ws...>, Data<>, Cs...>(sleeping_pool);
+                }
+                (With{});
+            }
+
+            /**
+             * Constructs a query excluding specific components defined in `Without`.
+             * 
+             * @tparam Without A `Data<>` wrapper containing components to exclude from the match.
+             * @tparam Cs... The primary components to query for. This must be a set of 
+             * Query-compatible types.
+             * 
+             * @param sleeping_pool False by default, updates the query
+             * for the sleeping pool if true, living pool if false.
+             * 
+             * @returns A query excluding components from `Without`.
+             */
+            template <typename Without, typename... Cs>
+            auto query_without(bool sleeping_pool = false) -> Query<Cs...>
+            {
+                return make_query<Data<Cs...>, Without, Cs...>(sleeping_pool);
+            }
+
+            /**
+             * Constructs a query including components from `With` and excluding those from `Without`.
+             * Expands `With` into its components and combines it with the exclusion from `Without`.
+             * 
+             * @tparam With A `Data<>` wrapper containing components to include.
+             * @tparam Without A `Data<>` wrapper containing components to exclude.
+             * @tparam Cs... The primary components to query for. This must be a set of Query-compatible types.
+             * 
+             * @param sleeping_pool False by default, updates the query
+             * for the sleeping pool if true, living pool if false.
+             * 
+             * @returns A query with included and excluded components.
+             */
+            template <typename With, typename Without, typename... Cs>
+            auto query_with_without(bool sleeping_pool = false) -> Query<Cs...>
+            {
+                return [this, &sleeping_pool]<typename... Ws>(Data<Ws...>)
+                {
+                    return make_query<Data<Cs..., Ws...>, Without, Cs...>(sleeping_pool);
+                }
+                (With{});            
+            }
+
+            /**
+             * A safe, single-access component lookup.
+             * 
+             * @tparam A The archetype to check. 
+             * @tparam Cs... The components to filter for. 
+             * 
+             * @param id The entity to view.
+             * 
+             * @returns A View: nullopt if the Archetype is incorrect or the entity is dead, 
+             * a tuple of component references if correct.
+             */
+            template <typename A, typename... Cs>
+            auto view(EntityId id) -> View<Cs...>
+            {
+                if (!is_type<A>(id)) return std::nullopt;
+
+                size_t slot = id_slot(id);
+                EntityState state = m_entities.states[slot];
+
+                if (state == DEAD) return std::nullopt;
+
+                return storage<A>().template get<Cs...>(m_entities.indices[slot], is_sleeping(state));
+            }
+
+            /**
+             * An unsafe, single-access component lookup. Panics.
+             * 
+             * @tparam A The archetype to check. 
+             * @tparam Cs... The components to filter for. 
+             * 
+             * @param id The entity to get.
+             * 
+             * @throws The Archetype does not match the type in the metadata.
+             * @throws The entity is dead.
+             * 
+             * @returns A tuple of component references.
+             */
+            template <typename A, typename... Cs>
+            auto get(EntityId id) -> Data<Cs&...>
             {
-                std::cout << "----------------------------------------\n";
-                std::cout << "|---EMPTY---|\n";
-                std::cout << "----------------------------------------\n";
-                return;
-            };
+                validate(id);
 
-            for (size_t index = 0; index < pool.count(); index++)
-            {
-                print_entity<A>(pool.ids()[index]);
-            }
-        };
+                if (!m_entities.is_current(id))
+                {
+                    throw std::invalid_argument("Cannot perform GET with a stale handle. Use VIEW or FIND instead.");
+                }
 
-        void print_all() 
-        {
-            std::cout << "\n==== NECS Debug ====\n";
+                if (!is_type<A>(id))
+                {
+                    throw std::invalid_argument("Cannot perform GET with an incorrect entity type.");
+                }
 
-            (print_storage<As>(),...);
+                size_t slot = id_slot(id);
+                EntityState state = m_entities.states[slot];
 
-            std::cout << "\n";
-        };
-    };
+                if (state == DEAD)
+                {
+                    throw std::invalid_argument("Cannot perform GET on a DEAD entity. Use VIEW or FIND instead.");             
+                }
 
-    // ----------------------------------------------------------------------------
-    // Registry
-    // ---------------------------------------------------------------------------- 
+                return storage<A>().template get<Cs...>(m_entities.indices[slot], is_sleeping(state));
+            }
 
-    /**
-     * The main API / entry point for interacting with system data.
-     * Contains functions for creating, removing & querying entities.
-     */
-    template 
-    <
-        typename Archetypes, 
-        typename Events, 
-        typename Singletons
-    >
-    class Registry
-    {
-        Entities m_entities;
-        Storages<Archetypes> m_storages;
-        Listeners<Archetypes, Events> m_listeners;
-        Singletons m_singletons;
+            /**
+             * A super safe lookup. 
+             * 
+             * Reads the entity's archetype once and jumps straight to its 
+             * storage through a table of the archetypes containing Cs, built at 
+             * compile time.
+             * 
+             * @tparam Cs... The components to filter for. 
+             * 
+             * @param id The entity to find.
+             * 
+             * @returns A View: nullopt if the Archetype is incorrect or the entity is dead, 
+             * a tuple of component references if correct.
+             */
+            template <typename... Cs>
+            auto find(EntityId id) -> View<Cs...>
+            {
+                using Finder = View<Cs...> (Registry::*)(size_t);
 
-        bool m_run_callbacks = true;
-        
-        // ---- Private access ---- //
+                static constexpr auto finders = []<typename... As>(std::type_identity<Data<As...>>)
+                {
+                    return std::array<Finder, sizeof...(As)>{finder<As, Cs...>()...};
+                }
+                (std::type_identity<Archetypes>{});
 
-        template <typename A>
-        auto storage() -> Storage<A>&
-        {
-            return std::get<Storage<A>>(m_storages);
-        }
+                if (!m_entities.is_current(id)) return std::nullopt;
 
-        template <typename A>
-        auto pool(bool sleeping_pool) -> Pool<A>&
-        {
-            return storage<A>().pool(sleeping_pool);
-        }
+                size_t slot = id_slot(id);
+                Finder f = finders[m_entities.archetypes[slot]];
 
-        template <typename E>
-        auto listener() -> Listener<E>&
-        {
-            return std::get<Listener<E>>(m_listeners);
-        }
+                if (f == nullptr || m_entities.states[slot] == DEAD) return std::nullopt;
 
-        // ---- Utils ---- //
+                return (this->*f)(slot);
+            }
+            
+            // ---- Change ticks ---- //
 
-        template <typename A>
-        void on_update()
-        {
-            call<DataUpdated<A>>({});
+            /**
+             * Gets the current tick. Changes are stamped with it when components
+             * are accessed mutably through get, view or find, marked with 
+             * mark_changed, or when entities are added to a pool.
+             * 
+             * Queries stamp their mutable components too: range-for loops and 
+             * for_each stamp every entity they visit, each_chunk every span it 
+             * hands out and par_for_each every slice. Const components are 
+             * never stamped, and neither are query_changed or query_added, so 
+             * reading changes does not mark them again.
+             */
+            Tick tick() const
+            {
+                return m_tick;
+            }
 
-            [this]<typename... Cs>(Data<Cs...>)
+            /**
+             * Closes the current tick and moves on to the next one. 
+             * 
+             * A system that reacts to changes keeps the tick returned here and 
+             * passes it as since on its next run: everything stamped after the 
+             * call, including changes made later in the same frame, is newer.
+             * 
+             * @returns The tick that was closed.
+             */
+            Tick next_tick()
             {
-                ((call<DataUpdated<Cs>>({})),...);
+                return m_tick++;
             }
-            (A{});
-        }
 
-        template <typename A>
-        void apply(EntityId id)
-        {
-            auto& s = storage<A>();
-            auto& [_, index, state, id_locked] = m_entities.data[id].info;
-            
-            switch (state)
+            /**
+             * Stamps a component of an entity as changed with the current tick.
+             * Needed for changes made through query_changed, query_added or 
+             * through references kept past the tick they were taken at. 
+             * Dispatches on the entity's archetype like find.
+             * 
+             * @tparam C The changed component.
+             * 
+             * @param id The changed entity, ignored if stale or dead.
+             */
+            template <typename C>
+            void mark_changed(EntityId id)
             {
-                case AWAKE:
-                {
-                    s.living.add(id, s.sleeping.clone(index)); // copy entity into living
-                    EntityId swapped_entity = s.sleeping.remove(index);
-                    m_entities.data[swapped_entity].info.index = index;
-                    index = s.living.count() - 1;
-                    break;
-                };
-                case KILLED: 
-                {
-                    EntityId swapped_entity = s.living.remove(index);
-                    m_entities.data[swapped_entity].info.index = index;
-                    if (!id_locked)
-                    {
-                        m_entities.to_reuse.push_back(id);
-                    }
-                    break;
-                };
-                case SNOOZED:
-                {
-                    s.sleeping.add(id, s.living.clone(index)); // copy entity into living
-                    EntityId swapped_entity = s.living.remove(index);
-                    m_entities.data[swapped_entity].info.index = index;
-                    index = s.sleeping.count() - 1;
-                    break;
-                };
-                default:
+                using Marker = void (Registry::*)(size_t);
+
+                static constexpr auto markers = []<typename... As>(std::type_identity<Data<As...>>)
                 {
-                    return;
-                };
-            }
+                    return std::array<Marker, sizeof...(As)>{marker<As, C>()...};
+                }
+                (std::type_identity<Archetypes>{});
 
-            EntityState req_state = state;
-            EntityState res_state = 
-                req_state == AWAKE 
-                ? LIVE
-                : req_state == KILLED
-                ? DEAD
-                : SLEEPING;
+                if (!m_entities.is_current(id)) return;
 
-            m_entities.counter[req_state]--;
-            m_entities.counter[res_state]++;
-            state = res_state;
+                size_t slot = id_slot(id);
+                Marker f = markers[m_entities.archetypes[slot]];
 
-            if (m_run_callbacks) 
-            {
-                call<EntityUpdated>({id, req_state, res_state});
-                on_update<A>();
+                if (f == nullptr || m_entities.states[slot] == DEAD) return;
+
+                (this->*f)(slot);
             }
-        }
 
-        template <typename Ws = Data<>, typename Wos = Data<>>
-        auto match()
-        {
-            return [this] <size_t... Is>(std::index_sequence<Is...>)
+            /**
+             * Constructs a query over the entities whose Changed component was 
+             * stamped after a tick. 
+             * 
+             * @tparam Changed The component to check for changes, it does not have to be in Cs.
+             * @tparam Cs... The components to query for.
+             * 
+             * @param since Entities stamped at or before this tick are skipped.
+             * @param sleeping_pool Whether to query the sleeping pool instead.
+             * 
+             * @returns A query filtered on change ticks.
+             */
+            template <typename Changed, typename... Cs>
+            auto query_changed(Tick since, bool sleeping_pool = false) -> Changes<Cs...>
             {
-                return std::tie(std::get<Is>(m_storages)...);
+                return {make_tracked_query<Data<Cs..., Changed>, Data<>, Changed, Cs...>(sleeping_pool), since};
             }
-            (Filter::Match<Archetypes, Ws, Wos>{});
-        }
 
-        public:
+            /**
+             * Constructs a query over the entities added to a pool after a tick.
+             * Entities that move between the living and sleeping pools count as added.
+             * 
+             * @tparam Cs... The components to query for.
+             * 
+             * @param since Entities added at or before this tick are skipped.
+             * @param sleeping_pool Whether to query the sleeping pool instead.
+             * 
+             * @returns A query filtered on the ticks at which entities were added.
+             */
+            template <typename... Cs>
+            auto query_added(Tick since, bool sleeping_pool = false) -> Changes<Cs...>
+            {
+                return {make_tracked_query<Data<Cs...>, Data<>, Added, Cs...>(sleeping_pool), since};
+            }
 
-            // ---- Checks ---- //
+            // ---- Create ---- //
 
             /**
-             * Performs a runtime typecheck on the entity.
+             * Creates an entity by copying it.
+             * Create operations change memory instantly for their affected pool.
              * 
-             * @tparam A The archetype to check.
+             * @tparam A The archetype of the entity passed in.
              * 
-             * @param id The entity to check.
+             * @param entity The entity to add.
              * 
-             * @returns True is the type matches the type in the entity 
-             * metadata, false if not.
+             * @returns The new entity's id.
              */
             template <typename A>
-            bool is_type(EntityId id) 
+            auto create(const A& entity) -> EntityId
             {
-                auto& i = info(id);
-                return i.type == std::type_index(typeid(A));
+                return add<A>(entity);
             }
 
             /**
-             * Performs a state check on the entity.
+             * Creates an entity by moving its components into the pool.
              * 
-             * @param id The entity to check.
-             * @param state The state to check.
+             * @tparam A The archetype of the entity passed in.
              * 
-             * @returns True if state matches the state in the entity 
-             * metadata, false if not.
+             * @param entity The entity to add.
+             * 
+             * @returns The new entity's id.
              */
-            bool is_state(EntityId id, EntityState state)
+            template <typename A> requires (!std::is_reference_v<A>)
+            auto create(A&& entity) -> EntityId
             {
-                auto& i = info(id);
-                return i.state == state;
+                return add<A>(std::move(entity));
             }
 
             /**
-             * Checks if an entity's id has been locked (removed from reuse).
+             * Creates an entity by constructing its components in place.
              * 
-             * @param id The entity to check.
+             * @tparam A The archetype of the entity.
+             * @tparam Args One constructor argument per component, in archetype order.
              * 
-             * @returns The entity's id_locked status.
+             * @param args The arguments to construct each component from.
+             * 
+             * @returns The new entity's id.
              */
-            bool is_locked(EntityId id)
+            template <typename A, typename... Args>
+            auto emplace(Args&&... args) -> EntityId
             {
-                auto& i = info(id);
-                return i.is_locked;
-            }
+                Pool<A>& p = pool<A>(false);
+
+                EntityId id = m_entities.create
+                ({
+                    archetype_id<A>, 
+                    static_cast<PoolIndex>(p.count()), 
+                    LIVE
+                });
+
+                p.emplace(id, std::forward<Args>(args)...);
+
+                on_create<A>(id);
 
+                return id;
+            }
+            
             /**
-             * Performs a check on the pool.
+             * Populates the registry with copies of an entity.
+             * Reserves memory once, constructs the columns in bulk and fires a 
+             * single EntitiesCreated event instead of one EntityCreated per entity.
              * 
-             * @tparam A The archetype pool to check.
+             * Dead slots are reused first, like create does, and only the rest of 
+             * the batch takes new slots, so the ids of a batch are not consecutive 
+             * once entities have died.
              * 
-             * @param sleeping_pool False by default, checks sleeping pool if 
-             * true, living pool if false.
+             * If constructing any entity throws, the whole batch is rolled back 
+             * and no entity of it is created.
              * 
-             * @returns True if the pool's non-dead entities are 0, false
-             * if not.
+             * @tparam A The archetype of the entity passed in.
+             * 
+             * @param entity The entity to add.
+             * @param count The amount of entities to create.
+             * 
+             * @returns The ids of the new entities, in pool order.
              */
             template <typename A>
-            bool is_empty(bool sleeping_pool = false)
+            auto populate(const A& entity, size_t count) -> std::vector<EntityId>
             {
-                return pool_count<A>(sleeping_pool) == 0;
+                NECS_TRACE_SCOPE("Registry::populate");
+
+                return create_block<A>(count, [&entity](Pool<A>& p, std::span<const EntityId> ids)
+                {
+                    p.fill(ids, entity);
+                });
             }
 
-            template <typename C>
-            bool has_component(EntityId id)
+            /**
+             * Populates the registry with a range of entities of the same archetype.
+             * 
+             * @tparam Range A sized range of archetype tuples.
+             * 
+             * @param entities The entities to add.
+             * 
+             * @returns The ids of the new entities, in range order.
+             */
+            template <std::ranges::sized_range Range>
+            auto populate(Range&& entities) -> std::vector<EntityId>
             {
-                auto& data = m_entities.data[id];
+                NECS_TRACE_SCOPE("Registry::populate");
 
-                return data.has_component(std::type_index(typeid(C)));
-            }
+                using A = std::ranges::range_value_t<Range>;
 
-            // ---- Counters ---- //
+                return create_block<A>(std::ranges::size(entities), [&entities](Pool<A>& p, std::span<const EntityId> ids)
+                {
+                    size_t i = 0;
+
+                    for (auto&& entity : entities)
+                    {
+                        p.add(ids[i++], std::forward<decltype(entity)>(entity));
+                    }
+                });
+            }
 
             /**
-             * Gets the number of total entities of any state currently in the system.
+             * Populates the registry with generated entities.
+             * 
+             * @tparam A The archetype of the entities.
+             * @tparam Generator Must be invocable<size_t> and return A, it is 
+             * called with the index of each entity in the block.
              * 
-             * This includes dead entities.
+             * @param count The amount of entities to create.
+             * @param generator The function to construct entities with.
+             * 
+             * @returns The ids of the new entities, in generation order.
              */
-            size_t total()
+            template <typename A, typename Generator>
+            auto populate(size_t count, Generator&& generator) -> std::vector<EntityId>
             {
-                return m_entities.data.size();
+                static_assert(std::is_convertible_v<std::invoke_result_t<Generator, size_t>, A>, "@Registry::populate: Generator must return the archetype.");
+
+                NECS_TRACE_SCOPE("Registry::populate");
+
+                return create_block<A>(count, [&generator](Pool<A>& p, std::span<const EntityId> ids)
+                {
+                    for (size_t i = 0; i < ids.size(); i++)
+                    {
+                        p.add(ids[i], generator(i));
+                    }
+                });
             }
-            
+
+            // ---- Memory management ---- //
+
             /**
-             * Gets the number of total entities in a state currently in the system.
+             * Trims dead memory from the end of each pool.
              * 
-             * @param state The state to check.
+             * @tparam A The storage to trim.
              */
-            size_t state_total(EntityState state)
+            template <typename A>
+            void trim()
             {
-                return m_entities.counter[state];
+                Storage<A>& s = storage<A>();
+                s.living.trim();
+                s.sleeping.trim();
             }
 
             /**
-             * Gets the total capacity of a pool, iterable and dead.
+             * Reserves room for a number of entities in a pool, along with the 
+             * metadata of that many new entities. Use it at startup when the 
+             * capacities are known to avoid reallocating columns while populating.
              * 
-             * @tparam A The archetype pool to check.
+             * @tparam A The storage to reserve memory in.
              * 
-             * @param sleeping_pool False by default, checks sleeping pool if 
-             * true, living pool if false.     
+             * @param count The number of entities the pool should hold without reallocating.
+             * @param sleeping_pool Whether to reserve in the sleeping pool instead.
              */
             template <typename A>
-            size_t pool_total(bool sleeping_pool = false)
+            void reserve(size_t count, bool sleeping_pool = false)
             {
-                return pool<A>(sleeping_pool).total();
+                Pool<A>& p = pool<A>(sleeping_pool);
+
+                if (count > p.count()) 
+                {
+                    m_entities.reserve(m_entities.size() + count - p.count());
+                }
+
+                p.reserve(count);
             }
 
             /**
-             * Gets the iterable number of entities in a pool.
-             * 
-             * @tparam A The archetype pool to check.
-             * 
-             * @param sleeping_pool False by default, checks sleeping pool if 
-             * true, living pool if false.
+             * Reserves metadata for a total number of entities across all archetypes.
              */
-            template <typename A>
-            size_t pool_count(bool sleeping_pool = false)
+            void reserve_entities(size_t count)
             {
-                return pool<A>(sleeping_pool).count();
+                m_entities.reserve(count);
             }
- 
-            // ---- Events ---- //
 
             /**
-             * Adds a callback to an event listener.
+             * Sets the memory resource that an archetype's pools allocate from. 
+             * Existing components are moved into the new memory.
              * 
-             * @tparam E The event of the listener. 
-             * @tparam Callback invocable<E>. 
+             * Any std::pmr resource works, e.g. a monotonic arena for archetypes 
+             * that only grow, or a HugePageResource for very large pools. The 
+             * resource is not owned and must outlive the registry.
              * 
-             * @param callback The function to call for this event.
+             * Parallel updates allocate from the pools of several archetypes at 
+             * once. Arenas and the other unsynchronized std::pmr resources are 
+             * not thread-safe, so the archetypes using them are updated one 
+             * after the other, after the parallel part, unless the resource is 
+             * declared synchronized.
+             * 
+             * @tparam A The storage whose pools to move.
              * 
-             * @throws Callback is not invocable<E>. 
+             * @param resource The resource to allocate from.
+             * @param synchronized Whether the resource is safe to allocate from 
+             * concurrently, like std::pmr::synchronized_pool_resource or a 
+             * HugePageResource over a thread-safe upstream.
              */
-            template <typename E, typename Callback>
-            void subscribe(Callback&& callback)
+            template <typename A>
+            void set_resource(std::pmr::memory_resource* resource, bool synchronized = false)
             {
-                static_assert(std::is_invocable_v<Callback, E>, "@Registry::subscribe: Event callback must take event as argument.");
+                Storage<A>& s = storage<A>();
+                s.living.set_resource(resource);
+                s.sleeping.set_resource(resource);
 
-                auto& l = listener<E>();
-                l.callback = callback;
-                l.ready = true;
-                l.set = true;
+                m_unsynchronized[archetype_id<A>] = !synchronized && resource != std::pmr::get_default_resource();
             }
 
             /**
-             * Marks a callback as not ready.
-             * 
-             * @tparam E The event of the listener.
+             * Sets the rules for giving pool memory back, applied at the end of 
+             * every update. See TrimPolicy.
              */
-            template <typename E>
-            void close()
+            void trim_policy(const TrimPolicy& policy)
             {
-                auto& l = listener<E>();
-                if (l.set) l.ready = false;
+                m_trim_policy = policy;
+            }
+
+            auto trim_policy() const -> const TrimPolicy&
+            {
+                return m_trim_policy;
             }
 
             /**
-             * Marks a previously set callback as ready again.
+             * Shrinks a pool right away: drops its dead slots and releases the 
+             * capacity its entities do not use.
              * 
-             * @tparam E The event of the listener.
+             * @tparam A The storage to shrink.
+             * 
+             * @param sleeping_pool Whether to shrink the sleeping pool instead.
              */
-            template <typename E>
-            void open()
+            template <typename A>
+            void shrink(bool sleeping_pool = false)
             {
-                auto& l = listener<E>();
-                if (l.set) l.ready = true;
+                pool<A>(sleeping_pool).shrink();
             }
 
             /**
-             * Calls the listener callback for this event.
+             * Gets the number of entities a pool can hold without allocating.
              * 
-             * @tparam E The event of the listener.
+             * @tparam A The storage to check.
              * 
-             * @param event The event to pass to the callback.
+             * @param sleeping_pool Whether to check the sleeping pool instead.
              */
-            template <typename E>
-            void call(E event)
+            template <typename A>
+            size_t capacity(bool sleeping_pool = false)
             {
-                auto& l = listener<E>();
-                if (l.ready) l.callback(event);
+                return pool<A>(sleeping_pool).capacity();
             }
 
-            // ---- Data access  ---- //
-
             /**
-             * Creates a debugger class to expose storages and entities. 
-             * 
-             * @returns A new debugger.
+             * Gets the number of bytes reserved by every pool, counting the 
+             * columns, ids and change ticks. The memory budget of the trim 
+             * policy applies to this number.
              */
-            auto debugger()
+            size_t memory()
             {
-                return Debugger{m_entities, m_storages};
+                return [this]<typename... As>(std::type_identity<Data<As...>>)
+                {
+                    return ((pool<As>(false).memory() + pool<As>(true).memory()) + ... + 0);
+                }
+                (std::type_identity<Archetypes>{});
             }
 
             /**
-             * Gets the entity's location info.
+             * Reports the memory used by the registry, per archetype, pool and 
+             * column, along with the entity metadata, event channels and 
+             * command buffers. 
+             * 
+             * Only capacities are read unless components are HeapSized, so it 
+             * is cheap enough to sample every frame. Pass the same report back 
+             * in to avoid allocating.
+             * 
+             * @param report The report to fill.
              */
-            auto info(EntityId id) -> const EntityInfo& 
+            void memory_report(MemoryReport& report)
             {
-                if (id >= total())
+                report.archetypes.resize(std::tuple_size_v<Archetypes>);
+                report.pool_bytes = 0;
+                report.heap_bytes = 0;
+
+                [this, &report]<typename... As>(std::type_identity<Data<As...>>)
+                {
+                    auto f = [this, &report]<typename A>(std::type_identity<A>)
+                    {
+                        ArchetypeReport& a = report.archetypes[archetype_id<A>];
+                        a.name = typeid(A).name();
+
+                        for (bool sleeping_pool : {false, true})
+                        {
+                            PoolReport& p = sleeping_pool ? a.sleeping : a.living;
+                            pool<A>(sleeping_pool).report(p);
+                            report.pool_bytes += p.bytes;
+                            report.heap_bytes += p.heap_bytes;
+                        }
+                    };
+
+                    (f(std::type_identity<As>{}),...);
+                }
+                (std::type_identity<Archetypes>{});
+
+                report.metadata_bytes = m_entities.memory() + m_updating.capacity() * sizeof(EntityId);
+
+                for (const Batch& batch : m_batches)
                 {
-                    std::cout << "Invalid EntityId: " << id;
-                    throw std::invalid_argument("Invalid EntityId");
+                    report.metadata_bytes += batch.ids.capacity() * sizeof(EntityId) + batch.indices.capacity() * sizeof(size_t);
                 }
 
-                return m_entities.data[id].info;
+                report.slots = m_entities.size();
+                report.reusable_slots = m_entities.to_reuse.size();
+
+                report.event_bytes = std::apply([](const auto&... listeners)
+                {
+                    return (listeners.memory() + ... + size_t(0));
+                }, 
+                m_listeners);
+
+                report.command_bytes = 0;
+                for (const auto& commands : m_commands) report.command_bytes += commands.memory();
+                for (const auto& commands : m_thread_commands) report.command_bytes += commands.memory();
             }
-            
+
+            auto memory_report() -> MemoryReport
+            {
+                MemoryReport report;
+                memory_report(report);
+                return report;
+            }
+
+            // ---- Sorting ---- //
 
             /**
-             * Returns a read-only reference to the ids of a pool.
+             * Sorts a pool by one of its components for locality, e.g. in 
+             * spatial or draw order. One permutation is computed and applied to 
+             * every column, the ids and the change ticks, and the indices of the 
+             * moved entities are fixed up in bulk. Entity ids stay the same.
              * 
-             * @tparam A The storage to get the pool from.
+             * Must not be called while iterating over the pool.
              * 
-             * @param sleeping_pool Whether to get the sleeping pool or not.
+             * @tparam A The archetype of the pool.
+             * @tparam C The component to sort by.
+             * @tparam By Either a key, invocable<const C&>, or a comparison, 
+             * invocable<const C&, const C&>. Integral keys are radix sorted.
+             * 
+             * @param by The key or comparison, std::less by default.
+             * @param sleeping_pool Whether to sort the sleeping pool instead.
+             * @param mode FULL_SORT by default, INSERTION_SORT for nearly sorted pools.
              */
-            template <typename A>
-            auto ids(bool sleeping_pool = false) -> const std::vector<EntityId>&
+            template <typename A, typename C, typename By = std::less<>>
+            void sort(By&& by = {}, bool sleeping_pool = false, SortMode mode = FULL_SORT)
             {
-                return pool<A>(sleeping_pool).ids();
+                pool<A>(sleeping_pool).template sort_by<C>(std::forward<By>(by), mode, [this](EntityId id, size_t index)
+                {
+                    m_entities.indices[id_slot(id)] = static_cast<PoolIndex>(index);
+                });
             }
 
+            // ---- Snapshots ---- //
+
             /**
-             * Returns a read-only vector of components from a pool.
+             * Writes the registry to a versioned binary snapshot: the entity 
+             * metadata with its reusable slots and queued ids, then both pools 
+             * of every archetype column by column, then the singletons. 
+             * 
+             * Trivially copyable components are written as raw blocks of 
+             * memory, other components need a Serializer. Subscriptions, 
+             * change ticks and command buffers are not saved.
+             * 
+             * Must not be called while iterating or updating.
+             * 
+             * @param out A binary stream to write to.
              */
-            template <typename A, typename C>
-            auto vector(bool sleeping_pool = false) -> const std::vector<C>&
+            void save(std::ostream& out)
             {
-                return pool<A>(sleeping_pool).template vector<C>();
+                NECS_TRACE_SCOPE("Registry::save");
+
+                static_assert(snapshot_serializable, "@Registry::save: Components and singletons must be trivially copyable or have a Serializer.");
+
+                out.write(SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+                write_value<uint32_t>(out, SNAPSHOT_VERSION);
+
+                std::vector<uint64_t> layout = snapshot_layout();
+                write_value<uint64_t>(out, layout.size());
+                write_bytes(out, layout.data(), layout.size());
+
+                write_value(out, m_tick);
+                m_entities.save(out);
+
+                [this, &out]<typename... As>(std::type_identity<Data<As...>>)
+                {
+                    ((pool<As>(false).save(out), pool<As>(true).save(out)),...);
+                }
+                (std::type_identity<Archetypes>{});
+
+                std::apply([&out](const auto&... singletons) { (write_value(out, singletons),...); }, m_singletons);
             }
 
             /**
-             * Gets a singleton.
+             * Saves a snapshot to a file.
              * 
-             * @tparam S The singleton's type.
+             * @returns Whether the file could be written, including the final flush.
+             */
+            bool save(const std::string& path)
+            {
+                std::ofstream out(path, std::ios::binary);
+                save(out);
+                out.close();
+                return !out.fail();
+            }
+
+            /**
+             * Saves a snapshot to a file, writing the file on a background thread. 
+             * The whole snapshot is serialized into memory on the calling thread 
+             * first, including the Serializer of every component that is not 
+             * trivially copyable, so the registry can be changed as soon as this 
+             * returns. Only the file write happens in the background.
              * 
-             * @returns A reference to the singleton.
+             * @returns Whether the file could be written, once it is done.
              */
-            template <typename S>
-            auto singleton() -> S&
-            {   
-                return std::get<S>(m_singletons);
+            auto save_async(const std::string& path) -> std::future<bool>
+            {
+                std::ostringstream buffer(std::ios::binary);
+                save(buffer);
+
+                return std::async(std::launch::async, [path, data = std::move(buffer).str()]()
+                {
+                    NECS_TRACE_SCOPE("Registry::save_async");
+
+                    std::ofstream out(path, std::ios::binary);
+                    out.write(data.data(), static_cast<std::streamsize>(data.size()));
+                    out.close();
+                    return !out.fail();
+                });
             }
 
             /**
-             * Constructs a single query.
+             * Replaces the content of the registry with a snapshot written by 
+             * save. Every pool reserves its exact size once and is read in 
+             * bulk, entities keep their ids and dead slots are reused in the 
+             * same order as before. No events are fired. 
              * 
-             * @tparam Cs... The components to query for.
+             * Must not be called while iterating or updating. If it throws, the 
+             * registry is left partially loaded and should be cleared by 
+             * loading another snapshot or discarded.
              * 
-             * @param sleeping_pool False by default, updates the query
-             * for the sleeping pool if true, living pool if false. 
+             * @param in A binary stream to read from.
              * 
-             * @returns A query object.
+             * Pending updates and recorded commands are dropped before loading.
+             * 
+             * @throws std::runtime_error If the snapshot is from another format 
+             * version or set of archetypes, ends early, or holds metadata that is 
+             * out of range or does not match its pools.
              */
-            template <typename... Cs>
-            auto query(bool sleeping_pool = false) -> Query<Cs...>
+            void load(std::istream& in)
             {
-                return Query<Cs...>(match<Data<Cs...>>(), sleeping_pool);
+                NECS_TRACE_SCOPE("Registry::load");
+
+                char magic[sizeof(SNAPSHOT_MAGIC)] = {};
+                read_bytes(in, magic, sizeof(magic));
+
+                if (!std::equal(std::begin(magic), std::end(magic), std::begin(SNAPSHOT_MAGIC)))
+                {
+                    throw std::runtime_error("@Registry::load - not a snapshot.");
+                }
+
+                if (read_value<uint32_t>(in) != SNAPSHOT_VERSION)
+                {
+                    throw std::runtime_error("@Registry::load - unsupported snapshot version.");
+                }
+
+                std::vector<uint64_t> expected = snapshot_layout();
+
+                if (read_value<uint64_t>(in) != expected.size())
+                {
+                    throw std::runtime_error("@Registry::load - snapshot was saved by a registry with other archetypes.");
+                }
+
+                std::vector<uint64_t> layout(expected.size());
+                read_bytes(in, layout.data(), layout.size());
+
+                if (layout != expected)
+                {
+                    throw std::runtime_error("@Registry::load - snapshot was saved by a registry with other archetypes.");
+                }
+
+                // Changes recorded against the old world must not reach the loaded one.
+                for (Batch& batch : m_batches) 
+                {
+                    batch.ids.clear();
+                    batch.indices.clear();
+                }
+
+                m_updating.clear();
+                for (auto& commands : m_commands) commands.clear();
+                for (auto& commands : m_thread_commands) commands.clear();
+
+                read_value(in, m_tick);
+                m_entities.load(in, std::tuple_size_v<Archetypes>);
+
+                [this, &in]<typename... As>(std::type_identity<Data<As...>>)
+                {
+                    ((pool<As>(false).load(in), pool<As>(true).load(in)),...);
+                }
+                (std::type_identity<Archetypes>{});
+
+                std::apply([&in](auto&... singletons) { (read_value(in, singletons),...); }, m_singletons);
+
+                check_loaded();
             }
 
             /**
-             * Constructs an iterator for a single pool.
-             * 
-             * @tparam A The archetype storage to check. 
-             * @tparam Cs... The components to filter for. 
+             * Loads a snapshot from a file.
              * 
-             * @param sleeping_pool False by default, iterates the
-             * sleeping pool if true, living pool if false.              
-             *  
-             * @returns The pool's iterator.
+             * @throws std::runtime_error If the file cannot be opened or holds 
+             * no valid snapshot.
              */
-            template <typename A, typename... Cs>
-            auto query_in(bool sleeping_pool = false) -> Iterator<Cs...>
+            void load(const std::string& path)
             {
-                return storage<A>().template iter<Cs...>(sleeping_pool);
+                std::ifstream in(path, std::ios::binary);
+
+                if (!in) throw std::runtime_error("@Registry::load - could not open " + path + ".");
+
+                load(in);
             }
 
+            // ---- State management ---- //
+
             /**
-             * Constructs a query with additional component constraints using `With`.
-             * Expands `With` into its constituent components and includes them in the match.
-             * 
-             * @tparam With A `Data<>` wrapper containing components to include in the match.
-             * @tparam Cs... The primary components to query for. This must be a set of 
-             * Query-compatible types.
+             * Updates all the entities queued by queue().
              * 
-             * @param sleeping_pool False by default, updates the query
-             * for the sleeping pool if true, living pool if false.
+             * Queued entities are grouped by archetype and moved in bulk, pool 
+             * by pool. Double-entities will be skipped due to state tracking. 
+             * EntityUpdated events are fired afterwards in queue order, followed 
+             * by one set of DataUpdated events per affected archetype.
              * 
-             * @returns A query including components from `With`.
+             * @param preserve_order False by default, compacts pools instead of 
+             * swapping removed entities with the last one, which keeps the order
+             * of the remaining entities intact.
+             * @param parallel False by default, processes the archetypes on the 
+             * registry's thread pool. Archetypes with an unsynchronized memory 
+             * resource are processed serially afterwards, see set_resource.
              */
-            template <typename With, typename... Cs>
-            auto query_with(bool sleeping_pool = false) -> Query<Cs...>
+            void update(bool preserve_order = false, bool parallel = false)
             {
-                return [this, &sleeping_pool]<typename... Ws>(Data<Ws...>)
+                NECS_TRACE_SCOPE("Registry::update");
+
+                size_t count = m_entities.take_queue(m_updating);
+
+                if (count == 0) 
                 {
-                    return Query<Cs...>(match<Data<Cs..., Ws...>>(), sleeping_pool);
+                    maintain();
+                    return;
                 }
-                (With{});
+
+                for (size_t i = 0; i < count; i++)
+                {
+                    EntityId id = m_updating[i];
+                    m_batches[m_entities.archetypes[id_slot(id)]].ids.push_back(id);
+                }
+
+                using Handler = void (Registry::*)(Batch&, bool);
+                using Callback = void (Registry::*)();
+
+                static constexpr auto handlers = []<typename... As>(Data<As...>)
+                {
+                    return std::array<Handler, sizeof...(As)>{&Registry::apply_batch<As>...};
+                }
+                (Archetypes{});
+
+                static constexpr auto callbacks = []<typename... As>(Data<As...>)
+                {
+                    return std::array<Callback, sizeof...(As)>{&Registry::on_update<As>...};
+                }
+                (Archetypes{});
+
+                std::array<ArchetypeId, std::tuple_size_v<Archetypes>> active;
+                size_t active_count = 0;
+
+                for (size_t a = 0; a < m_batches.size(); a++)
+                {
+                    if (!m_batches[a].ids.empty()) active[active_count++] = a;
+                }
+
+                auto process = [this, &active, &preserve_order](size_t i)
+                {
+                    (this->*handlers[active[i]])(m_batches[active[i]], preserve_order);
+                };
+
+                if (parallel)
+                {
+                    // Archetypes on unsynchronized resources go last, one after the other.
+                    std::array<size_t, std::tuple_size_v<Archetypes>> order;
+                    size_t shared = 0;
+                    size_t serial = active_count;
+
+                    for (size_t i = 0; i < active_count; i++)
+                    {
+                        if (m_unsynchronized[active[i]]) order[--serial] = i;
+                        else order[shared++] = i;
+                    }
+
+                    workers().run(shared, [&process, &order](size_t i) { process(order[i]); });
+
+                    for (size_t i = shared; i < active_count; i++) process(order[i]);
+                }
+                else 
+                {
+                    for (size_t i = 0; i < active_count; i++) process(i);
+                }
+
+                for (size_t i = 0; i < count; i++)
+                {
+                    EntityId id = m_updating[i];
+                    EntityState res_state = m_entities.states[id_slot(id)];
+                    EntityState req_state = 
+                        res_state == LIVE 
+                        ? AWAKE 
+                        : res_state == DEAD 
+                        ? KILLED 
+                        : SNOOZED;
+
+                    m_entities.counter[req_state]--;
+                    m_entities.counter[res_state]++;
+
+                    if (res_state == DEAD) m_entities.release(id);
+
+                    if constexpr (observes<EntityUpdated>)
+                    {
+                        if (m_run_callbacks) call<EntityUpdated>({id, req_state, res_state});
+                    }
+                }
+
+                if constexpr (observes_updates)
+                {
+                    if (m_run_callbacks)
+                    {
+                        for (size_t i = 0; i < active_count; i++) (this->*callbacks[active[i]])();
+                    }
+                }
+
+                maintain();
             }
 
             /**
-             * Constructs a query excluding specific components defined in `Without`.
-             * 
-             * @tparam Without A `Data<>` wrapper containing components to exclude from the match.
-             * @tparam Cs... The primary components to query for. This must be a set of 
-             * Query-compatible types.
+             * Queues an entity to be updated. 
+             * This is used when changes are made during iterations to
+             * preserve the order of entities.
              * 
-             * @param sleeping_pool False by default, updates the query
-             * for the sleeping pool if true, living pool if false.
+             * @param id The entity to queue.
+             * @param task The type of task to queue for. 
+             *              
+             * */
+            void queue(EntityId id, EntityTask task)
+            {
+                auto callback = [this, &id] ([[maybe_unused]] EntityState req_state, [[maybe_unused]] EntityState res_state) 
+                {
+                    if constexpr (observes<EntityUpdated>)
+                    {
+                        if (m_run_callbacks) call<EntityUpdated>({id, req_state, res_state});
+                    }
+                };
+
+                m_entities.queue(id, task, callback);
+            };
+        
+
+            /**
+             * Executes a state change for an entity instantly. 
+             * This will reallocate memory and swap the entity around. Avoid using
+             * during iterations.
              * 
-             * @returns A query excluding components from `Without`.
+             * @param id The entity to change.
+             * @param task The type of task to execute.
              */
-            template <typename Without, typename... Cs>
-            auto query_without(bool sleeping_pool = false) -> Query<Cs...>
+            void execute(EntityId id, EntityTask task)
             {
-                return Query<Cs...>(match<Data<Cs...>, Without>(), sleeping_pool);
+                m_entities.execute(id, task, [this](EntityId id) { dispatch(id); });
             }
+            
+
+            // ---- Commands ---- //
 
             /**
-             * Constructs a query including components from `With` and excluding those from `Without`.
-             * Expands `With` into its components and combines it with the exclusion from `Without`.
+             * Gets the command buffer of the calling thread. The thread that 
+             * made the registry and the workers of its thread pool each have a 
+             * buffer of their own. Any other thread, such as a worker of another 
+             * pool passed to par_for_each, gets a buffer registered under a lock 
+             * on its first call and cached per thread after. Commands are keyed 
+             * by where they were recorded, see CommandKey.
              * 
-             * @tparam With A `Data<>` wrapper containing components to include.
-             * @tparam Without A `Data<>` wrapper containing components to exclude.
-             * @tparam Cs... The primary components to query for. This must be a set of Query-compatible types.
-             * 
-             * @param sleeping_pool False by default, updates the query
-             * for the sleeping pool if true, living pool if false.
-             * 
-             * @returns A query with included and excluded components.
+             * @returns The calling thread's buffer, recorded into without locking.
              */
-            template <typename With, typename Without, typename... Cs>
-            auto query_with_without(bool sleeping_pool = false) -> Query<Cs...>
+            auto commands() -> CommandBuffer<Archetypes>&
             {
-                return [this, &sleeping_pool]<typename... Ws>(Data<Ws...>)
-                {
-                    return Query<Cs...>(match<Data<Cs..., Ws...>, Without>(), sleeping_pool);
-                }
-                (With{});            
+                size_t worker = m_workers ? m_workers->worker_index() : static_cast<size_t>(-1);
+
+                if (worker != static_cast<size_t>(-1)) return m_commands[worker + 1];
+
+                std::thread::id thread = std::this_thread::get_id();
+
+                if (thread == m_owner) return m_commands.front();
+
+                // The last registry and buffer used by this thread.
+                static thread_local std::pair<size_t, CommandBuffer<Archetypes>*> t_cached = {0, nullptr};
+
+                if (t_cached.first == m_serial) return *t_cached.second;
+
+                std::lock_guard lock(m_thread_mutex);
+
+                auto it = std::ranges::find(m_thread_buffers, thread, &std::pair<std::thread::id, CommandBuffer<Archetypes>*>::first);
+
+                CommandBuffer<Archetypes>* buffer = it != m_thread_buffers.end() 
+                    ? it->second 
+                    : m_thread_buffers.emplace_back(thread, &m_thread_commands.emplace_back()).second;
+
+                t_cached = {m_serial, buffer};
+
+                return *buffer;
             }
 
             /**
-             * A safe, single-access component lookup.
-             * 
-             * @tparam A The archetype to check. 
-             * @tparam Cs... The components to filter for. 
-             * 
-             * @param id The entity to view.
-             * 
-             * @returns A View: nullopt if the Archetype is incorrect or the entity is dead, 
-             * a tuple of component references if correct.
+             * Hands out a new command epoch. The scheduler takes one per run, so 
+             * that commands of repeated runs between two flushes keep distinct 
+             * keys, see CommandKey.
              */
-            template <typename A, typename... Cs>
-            auto view(EntityId id) -> View<Cs...>
+            uint64_t next_epoch()
             {
-                auto& i = info(id);
-
-                if (i.state == DEAD || !is_type<A>(id))
-                {
-                    return std::nullopt;
-                }
-
-                return storage<A>().template get<Cs...>(i.index, (i.state == SLEEPING || i.state == AWAKE));
+                return ++m_epoch;
             }
 
             /**
-             * An unsafe, single-access component lookup. Panics.
+             * Applies the commands of a buffer and clears it, without updating.
              * 
-             * @tparam A The archetype to check. 
-             * @tparam Cs... The components to filter for. 
-             * 
-             * @param id The entity to get.
+             * Entities are created first, in archetype order, in dead slots 
+             * before new ones. Component writes 
+             * follow, then state changes are queued. Every kind of command is 
+             * applied in the order it is stored in.
              * 
-             * @throws The Archetype does not match the type in the metadata.
-             * @throws The entity is dead.
-             * 
-             * @returns A tuple of component references.
+             * @param buffer The buffer to apply.
              */
-            template <typename A, typename... Cs>
-            auto get(EntityId id) -> Data<Cs&...>
+            void submit(CommandBuffer<Archetypes>& buffer)
             {
-                auto& i = info(id);
-
-                if (!is_type<A>(id))
+                [this, &buffer]<typename... As>(Data<As...>)
                 {
-                    throw std::invalid_argument("Cannot perform GET with an incorrect entity type.");
+                    auto create = [this]<typename A>(std::vector<std::pair<CommandKey, A>>& created)
+                    {
+                        if (created.empty()) return;
+
+                        create_deferred(created);
+                    };
+
+                    (create(buffer.template created<As>()),...);
+
+                    using Components = typename Filter::merge_types<As...>::type;
+
+                    [this, &buffer]<typename... Cs>(Data<Cs...>)
+                    {
+                        auto write = [this]<typename C>(std::vector<std::pair<CommandKey, std::pair<EntityId, C>>>& writes)
+                        {
+                            for (auto& [key, command] : writes)
+                            {
+                                auto& [id, component] = command;
+                                View<C> v = find<C>(id);
+
+                                if (v.has_value()) std::get<0>(v.value()) = std::move(component);
+                            }
+                        };
+
+                        (write(buffer.template writes<Cs>()),...);
+                    }
+                    (Components{});
                 }
+                (Archetypes{});
 
-                if (i.state == DEAD)
+                for (auto& [key, command] : buffer.tasks())
                 {
-                    throw std::invalid_argument("Cannot perform GET on a DEAD entity. Use VIEW or FIND instead.");             
+                    queue(command.first, command.second);
                 }
 
-                return storage<A>().template get<Cs...>(i.index, (i.state == SLEEPING || i.state == AWAKE));
+                buffer.clear();
             }
 
             /**
-             * A super safe lookup. 
+             * Sync point for deferred changes. Applies the command buffers of 
+             * every thread and updates the registry.
              * 
-             * Filters for and iterates over all the matching archetypes to find
-             * the desired components.
-             * 
-             * @tparam Cs... The components to filter for. 
-             * 
-             * @param id The entity to find.
+             * The buffers are merged and every kind of command is sorted by its 
+             * CommandKey, so created ids, the last write to a component and the 
+             * order of state changes do not depend on which worker recorded 
+             * them or on the number of workers. Must not be called while 
+             * workers are recording.
              * 
-             * @returns A View: nullopt if the Archetype is incorrect or the entity is dead, 
-             * a tuple of component references if correct.
+             * @param preserve_order Passed on to update().
+             * @param parallel Passed on to update().
              */
-            template <typename... Cs>
-            auto find(EntityId id) -> View<Cs...>
+            void flush(bool preserve_order = false, bool parallel = false)
             {
-                View<Cs...> v;
+                NECS_TRACE_SCOPE("Registry::flush");
 
-                [this, &v, &id]<typename... As>(Data<Storage<As>&...> storages)
-                {
-                    bool found = false;
+                auto& merged = m_commands.front();
 
-                    auto f = [this, &v, &id, &found]<typename A>(Storage<A>& s)
+                auto merge = [&merged](CommandBuffer<Archetypes>& buffer)
+                {
+                    [&merged, &buffer]<typename... As>(Data<As...>)
                     {
-                        if (found) return;
-
-                        if (is_type<A>(id))
+                        auto append = []<typename T>(std::vector<T>& to, std::vector<T>& from)
                         {
-                            found = true;
+                            to.insert(to.end(), std::make_move_iterator(from.begin()), std::make_move_iterator(from.end()));
+                        };
 
-                            auto& i = info(id);
+                        (append(merged.template created<As>(), buffer.template created<As>()),...);
 
-                            if (i.state != DEAD)
-                            {
-                                v = s.template get<Cs...>(i.index, (i.state == SLEEPING || i.state == AWAKE));
-                            }
+                        append(merged.tasks(), buffer.tasks());
+
+                        [&merged, &buffer, &append]<typename... Cs>(Data<Cs...>)
+                        {
+                            (append(merged.template writes<Cs>(), buffer.template writes<Cs>()),...);
                         }
-                    };  
+                        (typename Filter::merge_types<As...>::type{});
+                    }
+                    (Archetypes{});
+
+                    buffer.clear();
+                };
+
+                for (size_t i = 1; i < m_commands.size(); i++) merge(m_commands[i]);
+                for (auto& buffer : m_thread_commands) merge(buffer);
+
+                auto by_key = []<typename T>(std::vector<T>& commands)
+                {
+                    std::stable_sort(commands.begin(), commands.end(), [](const T& a, const T& b) { return a.first < b.first; });
+                };
+
+                by_key(merged.tasks());
+
+                [&merged, &by_key]<typename... As>(Data<As...>)
+                {
+                    (by_key(merged.template created<As>()),...);
 
-                    ((f(std::get<Storage<As>&>(storages))),...);
+                    [&merged, &by_key]<typename... Cs>(Data<Cs...>)
+                    {
+                        (by_key(merged.template writes<Cs>()),...);
+                    }
+                    (typename Filter::merge_types<As...>::type{});
                 }
-                (match<Data<Cs...>>());
+                (Archetypes{});
 
-                return v;
+                submit(merged);
+                update(preserve_order, parallel);
             }
-            
-            // ---- Create ---- //
 
-            /**
-             * Creates an entity.
-             * Create operations change memory instantly for their affected pool.
-             * 
-             * @tparam A The archetype of the entity passed in.
-             * 
-             * @param entity The entity to add.
-             * @param id_locked Should this entity's id be prevented from being reused.
-             * 
-             * @returns The new entity's id.
-             */
-            template <typename A>
-            auto create(A entity, bool id_locked = false) -> EntityId
+            // ---- Toggle ---- //
+
+            // Toggles whether internal callbacks should be called.
+            void toggle_callbacks(bool value)
             {
-                Storage<A>& s = storage<A>();
+                m_run_callbacks = value;
+            };
+            
+    };
 
-                auto [id, data] = m_entities.create
-                ({
-                    std::type_index(typeid(A)), 
-                    s.living.count(), 
-                    LIVE,
-                    id_locked
-                });
+    // ----------------------------------------------------------------------------
+    // Scheduler
+    // ---------------------------------------------------------------------------- 
+
+    /**
+     * Runs systems at the same time when their data does not overlap.
+     * 
+     * Every system declares the components of its query, const for the ones it 
+     * only reads. Two systems conflict when an archetype matches both queries 
+     * and one of them writes a component the other one reads or writes. Systems 
+     * keep the order they were added in: each one runs in the batch after the 
+     * last earlier system it conflicts with, and the systems of a batch run in 
+     * parallel on the registry's thread pool. A system without components 
+     * declares no access, so it conflicts with every other system and runs in 
+     * a batch of its own. Sync points flush the registry's command buffers and 
+     * update it between batches.
+     * 
+     * Systems must not make structural changes or touch singletons directly, 
+     * they record changes into Registry::commands instead.
+     * 
+     * @tparam R The registry type.
+     */
+    template <typename R>
+    class Scheduler;
+
+    template <typename Archetypes, typename Events, typename Singletons, typename Queries, typename Observed>
+    class Scheduler<Registry<Archetypes, Events, Singletons, Queries, Observed>>
+    {
+        using Owner = Registry<Archetypes, Events, Singletons, Queries, Observed>;
+        using ArchetypeSignatures = Signatures<Archetypes>;
+        using Components = typename ArchetypeSignatures::Type;
+        using Matches = Signature<std::tuple_size_v<Archetypes>>;
 
-                s.living.add(id, entity);
+        struct System
+        {
+            std::string name;
+            const char* trace_name = nullptr; // The name interned for tracing.
+            std::function<void()> run;
+            Matches archetypes; // The archetypes matched by the system's query.
+            Components reads; // The components read through const.
+            Components writes; // The components read and written.
+            bool exclusive = false; // Set for systems without components, which may touch anything.
+        };
+
+        // A batch of systems to run in parallel, or a sync point if sync is set.
+        struct Step
+        {
+            std::vector<size_t> systems;
+            bool sync = false;
+            bool preserve_order = false;
+            bool parallel = false;
+        };
+
+        Owner& m_registry;
+        std::vector<System> m_systems;
+        std::vector<Step> m_order; // Systems and sync points in the order they were added.
+        std::vector<Step> m_steps; // The batches built from m_order.
+        bool m_built = false;
+
+        static bool conflicts(const System& a, const System& b)
+        {
+            if (a.exclusive || b.exclusive) return true;
+            if (!a.archetypes.intersects(b.archetypes)) return false;
 
-                data.update = [this, id] () { apply<A>(id); };
+            return a.writes.intersects(b.reads | b.writes) || b.writes.intersects(a.reads);
+        }
+
+        // Groups systems into batches: between sync points, a system goes right after the last batch it conflicts with.
+        void build()
+        {
+            m_steps.clear();
+
+            size_t stage = 0;
+            std::vector<size_t> levels(m_systems.size(), 0);
 
-                data.has_component = [this] (std::type_index type)
+            for (const Step& entry : m_order)
+            {
+                if (entry.sync)
                 {
-                    Storage<A>& s = storage<A>();
+                    m_steps.push_back(entry);
+                    stage = m_steps.size();
+                    continue;
+                }
 
-                    // this will insert a component type as false by default
-                    return s.info.components[type];
-                };
-    
-                if (m_run_callbacks) 
+                size_t system = entry.systems.front();
+                size_t level = 0;
+
+                for (size_t step = stage; step < m_steps.size(); step++)
                 {
-                    call<EntityCreated>({id});
-                    on_update<A>();
+                    for (size_t other : m_steps[step].systems)
+                    {
+                        if (conflicts(m_systems[system], m_systems[other])) level = std::max(level, levels[other] + 1);
+                    }
                 }
 
-                return id;
+                levels[system] = level;
+
+                if (stage + level == m_steps.size()) m_steps.emplace_back();
+
+                m_steps[stage + level].systems.push_back(system);
             }
-            
+
+            m_built = true;
+        }
+
+        public: 
             /**
-             * Populates the registry with copies of an entity.
-             * Calls create under the hood and therefore instantly modifies memory.
+             * @param registry The registry the systems run on, must outlive the scheduler.
+             */
+            explicit Scheduler(Owner& registry) : m_registry(registry) {}
+
+            /**
+             * Adds a system. Its query is built right away, so that systems 
+             * never build query tables concurrently.
              * 
-             * @tparam A The archetype of the entity passed in.
+             * @tparam Cs... The components of the system's query, const for read-only ones.
+             * @tparam F Must be invocable<Query<Cs...>&>, or invocable<> without components, 
+             * in which case the system runs alone in its batch.
              * 
-             * @param entity The entity to add.
-             * @param count The amount of entities to create.
+             * @param name The name of the system, used by batches().
+             * @param system The system.
              */
-            template <typename A>
-            void populate(A entity, size_t count)
+            template <typename... Cs, typename F>
+            auto add(std::string name, F&& system) -> Scheduler&
             {
-                for (size_t i = 0; i < count; i++)
+                System s;
+                s.name = std::move(name);
+
+#if defined(NECS_TRACE)
+                s.trace_name = Tracer::instance().intern(s.name);
+#endif
+
+                if constexpr (sizeof...(Cs) == 0)
                 {
-                    create(entity);
+                    static_assert(std::is_invocable_v<F>, "@Scheduler::add: A system without components must take no arguments.");
+                    s.run = std::forward<F>(system);
+                    s.exclusive = true;
                 }
-            }
+                else 
+                {
+                    static_assert(std::is_invocable_v<F, Query<Cs...>&>, "@Scheduler::add: A system must take its query as argument.");
 
-            // ---- Memory management ---- //
+                    s.run = [query = m_registry.template query<Cs...>(), system = std::forward<F>(system)]() mutable
+                    {
+                        Query<Cs...> q = query;
+                        system(q);
+                    };
 
-            /**
-             * Trims dead memory from the end of each pool.
-             * 
-             * @tparam A The storage to trim.
-             */
-            template <typename A>
-            void trim()
-            {
-                Storage<A>& s = storage<A>();
-                s.living.trim();
-                s.sleeping.trim();
-            }
+                    constexpr auto matched = ArchetypeSignatures::template matched<Data<std::remove_const_t<Cs>...>, Data<>>;
 
-            // ---- State management ---- //
+                    for (size_t i = 0; i < matched.second; i++) s.archetypes.set(matched.first[i]);
+
+                    ((std::is_const_v<Cs> ? s.reads : s.writes).set(ArchetypeSignatures::template bit<Cs>),...);
+                }
+
+                m_order.push_back({{m_systems.size()}});
+                m_systems.push_back(std::move(s));
+                m_built = false;
+
+                return *this;
+            }
 
             /**
-             * Updates all the entities queued by queue().
+             * Adds a sync point: every system added before it is done before the 
+             * registry is flushed, see Registry::flush, and later systems start.
              * 
-             * The entities will be update in the order of ther addition to the 
-             * queue. Double-entities will be skipped due to state tracking.
+             * @param preserve_order Passed on to Registry::flush.
+             * @param parallel Passed on to Registry::flush.
              */
-            void update()
+            auto sync(bool preserve_order = false, bool parallel = false) -> Scheduler&
             {
-                m_entities.update();
+                m_order.push_back({{}, true, preserve_order, parallel});
+                m_built = false;
+
+                return *this;
             }
 
-            /**
-             * Queues an entity to be updated. 
-             * This is used when changes are made during iterations to
-             * preserve the order of entities.
-             * 
-             * @param id The entity to queue.
-             * @param task The type of task to queue for. 
-             *              
-             * */
-            void queue(EntityId id, EntityTask task)
+            // Runs every system once, batch by batch.
+            void run()
             {
-                auto callback = [this, &id] (EntityState req_state, EntityState res_state) 
+                if (!m_built) build();
+
+                ThreadPool& workers = m_registry.workers();
+                uint64_t epoch = m_registry.next_epoch();
+
+                for (Step& step : m_steps)
                 {
-                    if (m_run_callbacks) call<EntityUpdated>({id, req_state, res_state});
-                };
+                    if (step.sync)
+                    {
+                        m_registry.flush(step.preserve_order, step.parallel);
+                        continue;
+                    }
 
-                m_entities.queue(id, task, callback);
-            };
-        
+                    NECS_TRACE_SCOPE("Scheduler::batch");
+
+                    workers.run(step.systems.size(), [this, &step, epoch](size_t i)
+                    {
+                        System& system = m_systems[step.systems[i]];
+                        NECS_TRACE_SCOPE(system.trace_name);
+
+                        // Commands are ordered by system, wherever the system ran.
+                        CommandScope scope({epoch, step.systems[i] + 1, 0, 0, 0});
+                        system.run();
+                    });
+                }
+            }
 
             /**
-             * Executes a state change for an entity instantly. 
-             * This will reallocate memory and swap the entity around. Avoid using
-             * during iterations.
-             * 
-             * @param id The entity to change.
-             * @param task The type of task to execute.
+             * Gets the system names of every batch in run order, sync points 
+             * are empty batches.
              */
-            void execute(EntityId id, EntityTask task)
+            auto batches() -> std::vector<std::vector<std::string>>
             {
-                m_entities.execute(id, task);
-            }
-            
+                if (!m_built) build();
 
-            // ---- Toggle ---- //
+                std::vector<std::vector<std::string>> names;
 
-            // Toggles whether internal callbacks should be called.
-            void toggle_callbacks(bool value)
-            {
-                m_run_callbacks = value;
-            };
-            
+                for (const Step& step : m_steps)
+                {
+                    auto& batch = names.emplace_back();
+                    for (size_t system : step.systems) batch.push_back(m_systems[system].name);
+                }
+
+                return names;
+            }
     };
 };